@@ -0,0 +1,88 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+#include "calibration.h"
+
+// sensors included in the running sweep, 0 when there is no sweep
+uint16_t calibrationMask = 0;
+uint8_t calibrationScans = 0;
+uint8_t calibrationUpperMargin = CALIBRATION_DEFAULT_MARGIN;
+uint8_t calibrationLowerMargin = CALIBRATION_DEFAULT_MARGIN;
+
+/**
+ * @brief calculates the thresholds from the extremes stored in upper (max) and
+ * lower (min), sensors that were never scanned get the default thresholds.
+ */
+static void calibrationFinish(IRSensor* sensors){
+    for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
+        if(((calibrationMask >> i) & 1) == 0){
+            continue;
+        }
+        uint16_t max = sensors[i].upper;
+        uint16_t min = sensors[i].lower;
+        if(max < min){
+            sensors[i].upper = 0xFFFF;
+            sensors[i].lower = 0;
+            continue;
+        }
+        uint16_t span = max - min;
+        uint16_t mid = min + (span >> 1);
+        sensors[i].upper = mid + (uint16_t)(((uint32_t)span * calibrationUpperMargin) >> 8);
+        sensors[i].lower = mid - (uint16_t)(((uint32_t)span * calibrationLowerMargin) >> 8);
+    }
+    calibrationMask = 0;
+    calibrationScans = 0;
+}
+
+void calibrationStart(IRSensor* sensors, uint16_t mask, uint8_t scans, uint8_t upperMargin, uint8_t lowerMargin){
+    calibrationUpperMargin = upperMargin > CALIBRATION_MAX_MARGIN ? CALIBRATION_MAX_MARGIN : upperMargin;
+    calibrationLowerMargin = lowerMargin > CALIBRATION_MAX_MARGIN ? CALIBRATION_MAX_MARGIN : lowerMargin;
+    if(scans == 0){
+        if(calibrationMask != 0){
+            calibrationFinish(sensors);
+        }
+        return;
+    }
+    for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
+        if((mask >> i) & 1){
+            sensors[i].upper = 0;
+            sensors[i].lower = 0xFFFF;
+        }
+    }
+    calibrationMask = mask;
+    calibrationScans = scans;
+}
+
+bool calibrationUpdate(IRSensor* sensors, uint16_t mask){
+    if(calibrationMask == 0){
+        return false;
+    }
+    mask &= calibrationMask;
+    for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++, mask >>= 1){
+        if((mask & 1) == 0){
+            continue;
+        }
+        uint16_t value = sensors[i].value;
+        sensors[i].upper = value > sensors[i].upper ? value : sensors[i].upper;
+        sensors[i].lower = value < sensors[i].lower ? value : sensors[i].lower;
+    }
+    if(--calibrationScans == 0){
+        calibrationFinish(sensors);
+        return true;
+    }
+    return false;
+}
+
+bool calibrationRunning(){
+    return calibrationMask != 0;
+}
+
+uint8_t calibrationRemainingScans(){
+    return calibrationScans;
+}
+
+void calibrationGetMargins(uint8_t* upperMargin, uint8_t* lowerMargin){
+    *upperMargin = calibrationUpperMargin;
+    *lowerMargin = calibrationLowerMargin;
+}
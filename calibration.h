@@ -0,0 +1,97 @@
+/*
+ * File:                calibration.h
+ * Author:              Hector Manuel
+ * Comments:
+ * Revision history:
+ */
+
+
+#ifndef CALIBRATION_H
+#define	CALIBRATION_H
+
+/**
+ * @file calibration.h
+ *
+ * @brief on device calibration of the sensor thresholds.
+ *
+ * During a sweep the minimum and maximum value of every sensor are tracked
+ * over a number of scans, the master only moves the sensor bar over the line
+ * and the background and waits for the interrupt, no datagrams are needed.
+ * To save RAM the running maximum and minimum are kept in the upper and lower
+ * fields of the sensors, so the binary values are not valid while the sweep
+ * is running.
+ */
+
+#include <xc.h>
+#include "protocol_registers.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief default margins of the thresholds around the middle of the measured
+ * range, in 1/256 of the range.
+ */
+#define CALIBRATION_DEFAULT_MARGIN      64
+
+/**
+ * @brief largest margin, with it the thresholds are the measured extremes.
+ */
+#define CALIBRATION_MAX_MARGIN          128
+
+/**
+ * @brief starts a calibration sweep.
+ *
+ * @param[sensors] sensors to calibrate, the thresholds of the sensors in the
+ * mask are overwritten.
+ * @param[mask] sensors included in the sweep, one bit per sensor.
+ * @param[scans] amount of scans of the sweep, 0 ends a running sweep with
+ * the scans done so far.
+ * @param[upperMargin] the upper threshold is placed this much above the middle
+ * of the range, in 1/256 of the range up to CALIBRATION_MAX_MARGIN.
+ * @param[lowerMargin] the lower threshold is placed this much below the middle
+ * of the range, in 1/256 of the range up to CALIBRATION_MAX_MARGIN.
+ */
+void calibrationStart(IRSensor* sensors, uint16_t mask, uint8_t scans, uint8_t upperMargin, uint8_t lowerMargin);
+
+/**
+ * @brief adds a completed scan to the running sweep, when the last scan is
+ * added the thresholds are calculated.
+ *
+ * @param[sensors] sensors updated with the last scan.
+ * @param[mask] sensors converted in the last scan.
+ *
+ * @return true if the sweep completed with this scan.
+ */
+bool calibrationUpdate(IRSensor* sensors, uint16_t mask);
+
+/**
+ * @brief reports if a sweep is running.
+ *
+ * @return true while the sweep is running.
+ */
+bool calibrationRunning();
+
+/**
+ * @brief returns the scans left in the running sweep.
+ *
+ * @return scans left, 0 if no sweep is running.
+ */
+uint8_t calibrationRemainingScans();
+
+/**
+ * @brief returns the margins used by the last sweep.
+ *
+ * @param[upperMargin] destination of the upper margin.
+ * @param[lowerMargin] destination of the lower margin.
+ */
+void calibrationGetMargins(uint8_t* upperMargin, uint8_t* lowerMargin);
+
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* CALIBRATION_H */
+
@@ -0,0 +1,82 @@
+/*
+ * File:                crc8.h
+ * Author:              Hector Manuel
+ * Comments:
+ * Revision history:
+ */
+
+
+#ifndef CRC8_H
+#define	CRC8_H
+
+/**
+ * @file crc8.h
+ *
+ * @brief Incremental CRC-8 engine used by the one-wire protocol.
+ *
+ * The datagram CRC is a CRC-8 with polynomial 0x07 where each byte is fed LSB
+ * first. The running value is kept bit reflected so every byte can be
+ * processed with a table lookup, crc8Final converts it back to the value that
+ * travels on the bus.
+ */
+
+#include <xc.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief selects the lookup strategy at build time.
+ *
+ * 0: nibble table, 16 bytes of flash and two lookups per byte (default since
+ *    the ATtiny404 only has 4KB of flash).
+ * 1: full table, 256 bytes of flash and one lookup per byte.
+ */
+#ifndef CRC8_USE_FULL_TABLE
+#define CRC8_USE_FULL_TABLE 0
+#endif
+
+/**
+ * @brief initial value of the running CRC, the start of every datagram must
+ * reset the running value to this.
+ */
+#define CRC8_INIT 0x00
+
+/**
+ * @brief updates the running CRC with one byte.
+ *
+ * @param[crc] running CRC (reflected), start with CRC8_INIT.
+ * @param[byte] next byte of the datagram.
+ *
+ * @return the updated running CRC.
+ */
+uint8_t crc8Update(uint8_t crc, uint8_t byte);
+
+/**
+ * @brief converts the running CRC to the value that is sent or received in the
+ * last byte of a datagram, this is O(1).
+ *
+ * @param[crc] running CRC returned by crc8Update.
+ *
+ * @return the CRC as it's transmitted on the bus.
+ */
+uint8_t crc8Final(uint8_t crc);
+
+/**
+ * @brief calculates the CRC of a complete buffer.
+ *
+ * @param[data] pointer to the first byte.
+ * @param[length] amount of bytes to process.
+ *
+ * @return the CRC as it's transmitted on the bus.
+ */
+uint8_t crc8Block(const char* data, uint8_t length);
+
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* CRC8_H */
+
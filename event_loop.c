@@ -0,0 +1,86 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "event_loop.h"
+#include "mcc_generated_files/system/utils/atomic.h"
+
+// pending events (one bit per source) and the TCA0 tick when they were posted
+volatile uint8_t pendingEvents = 0;
+volatile uint16_t postTime[EVENT_SOURCE_COUNT];
+eventLatency_t eventLatency[EVENT_SOURCE_COUNT];
+
+void eventLoopInit(){
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    pendingEvents = 0;
+    eventClearLatency();
+}
+
+void eventPost(eventSource_t source){
+    uint8_t bit = 1 << source;
+    // it can also run in the main loop (e.g. a timer started with no delay)
+    ENTER_CRITICAL(post);
+    if((pendingEvents & bit) == 0){
+        postTime[source] = TCA0.SINGLE.CNT;
+        pendingEvents |= bit;
+    }
+    EXIT_CRITICAL(post);
+}
+
+void eventHandled(eventSource_t source){
+    uint8_t bit = 1 << source;
+    // the 16 bit read of CNT uses the TEMP register of TCA0 shared with the
+    // ISRs
+    ENTER_CRITICAL(handled);
+    if((pendingEvents & bit) == 0){
+        EXIT_CRITICAL(handled);
+        return;
+    }
+    pendingEvents &= ~bit;
+    uint16_t latency = TCA0.SINGLE.CNT - postTime[source];
+    EXIT_CRITICAL(handled);
+
+    eventLatency_t* stats = &eventLatency[source];
+    stats->last = latency;
+    if(latency > stats->max){
+        stats->max = latency;
+    }
+}
+
+void eventDiscard(eventSource_t source){
+    ENTER_CRITICAL(discard);
+    pendingEvents &= ~(1 << source);
+    EXIT_CRITICAL(discard);
+}
+
+void sleepIdle(){
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    cli();
+    sleep_disable();
+}
+
+void eventWait(){
+    ENTER_CRITICAL(wait);
+    while(pendingEvents == 0){
+        sleepIdle();
+    }
+    EXIT_CRITICAL(wait);
+}
+
+void eventGetLatency(eventSource_t source, eventLatency_t* latency){
+    ENTER_CRITICAL(get);
+    *latency = eventLatency[source];
+    EXIT_CRITICAL(get);
+}
+
+void eventClearLatency(){
+    ENTER_CRITICAL(clear);
+    for(uint8_t i = 0; i < EVENT_SOURCE_COUNT; i++){
+        eventLatency[i].last = 0;
+        eventLatency[i].max = 0;
+    }
+    EXIT_CRITICAL(clear);
+}
@@ -0,0 +1,151 @@
+/*
+ * File:                event_loop.h
+ * Author:              Hector Manuel
+ * Comments:
+ * Revision history:
+ */
+
+
+#ifndef EVENT_LOOP_H
+#define	EVENT_LOOP_H
+
+/**
+ * @file event_loop.h
+ *
+ * @brief sleeps the CPU between the events of the main loop and measures how
+ * long every event waits before it's handled.
+ *
+ * The ISRs post an event when they leave work for the main loop, the main
+ * loop marks it as handled when it consumes it and, when no event is pending,
+ * eventWait puts the CPU in IDLE sleep until the next interrupt. The check
+ * and the sleep are done with the interrupts disabled and sei is followed by
+ * sleep, so an event posted in between still wakes the CPU.
+ *
+ * IDLE is the only mode used, the ATtiny404 has no ADC noise reduction mode
+ * and in STANDBY TCA0 stops, but the CPU core is halted while the ADC
+ * converts which removes most of the digital noise of the main loop.
+ *
+ * The latency of an event is counted in TCA0 ticks from the moment it was
+ * posted until it was handled, so it includes the wake up and the work of the
+ * main loop that was already running, the scheduler must be initialized.
+ * Only the lower 16 bits of TCA0 are used, so latencies longer than a period
+ * (52ms at 20MHz) wrap.
+ */
+
+#include <xc.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @enum eventSource_t
+ *
+ * @brief sources of the events handled by the main loop.
+ *
+ * EVENT_DATAGRAM: a datagram was received.
+ * EVENT_REPLY:    the reply delay elapsed.
+ * EVENT_SCAN:     a scan completed.
+ */
+typedef enum {
+    EVENT_DATAGRAM = 0,
+    EVENT_REPLY,
+    EVENT_SCAN,
+    EVENT_SOURCE_COUNT
+} eventSource_t;
+
+/**
+ * @struct eventLatency_t
+ *
+ * @brief latency statistics of an event source in TCA0 ticks.
+ *
+ * last:  latency of the last handled event.
+ * max:   highest latency since the last clear.
+ */
+typedef struct {
+    uint16_t last;
+    uint16_t max;
+} eventLatency_t;
+
+/**
+ * @brief selects the IDLE sleep mode and clears the pending events and the
+ * statistics.
+ */
+void eventLoopInit();
+
+/**
+ * @brief marks an event as pending, this is called from the ISR that leaves
+ * the work for the main loop, it's also safe in the main loop.
+ *
+ * If the event was already pending the first timestamp is kept.
+ *
+ * @param[source] source of the event.
+ */
+void eventPost(eventSource_t source);
+
+/**
+ * @brief marks an event as handled and updates the latency statistics of its
+ * source, it's called by the main loop when it consumes the event.
+ *
+ * @param[source] source of the event.
+ */
+void eventHandled(eventSource_t source);
+
+/**
+ * @brief discards a pending event without updating the statistics, used when
+ * the work of the event was cancelled.
+ *
+ * @param[source] source of the event.
+ */
+void eventDiscard(eventSource_t source);
+
+/**
+ * @brief sleeps in IDLE until an event is posted, it returns right away if
+ * one is already pending.
+ *
+ * Other interrupts (e.g. the sample rate timer) wake the CPU too, they are
+ * serviced and the CPU sleeps again without returning.
+ *
+ * @warning it must be called with the interrupts enabled.
+ */
+void eventWait();
+
+/**
+ * @brief sleeps in IDLE until the next interrupt, used to wait for a variable
+ * changed by an ISR without polling it:
+ *
+ *     ENTER_CRITICAL(wait);
+ *     while(condition){
+ *         sleepIdle();
+ *     }
+ *     EXIT_CRITICAL(wait);
+ *
+ * The instruction after sei is always executed before an interrupt, so an
+ * interrupt that arrives after the condition was checked wakes the CPU from
+ * the sleep instead of being lost.
+ *
+ * @warning it must be called with the interrupts disabled, they are disabled
+ * again when it returns.
+ */
+void sleepIdle();
+
+/**
+ * @brief returns the latency statistics of an event source.
+ *
+ * @param[source] source of the events.
+ * @param[latency] copy of the statistics, taken atomically.
+ */
+void eventGetLatency(eventSource_t source, eventLatency_t* latency);
+
+/**
+ * @brief clears the latency statistics of all the sources.
+ */
+void eventClearLatency();
+
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* EVENT_LOOP_H */
+
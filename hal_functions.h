@@ -12,6 +12,20 @@
 
 #include <xc.h> 
 
+/**
+ * @brief backends available to drive the sensor select shift registers.
+ * 
+ * SHIFT_REGISTER_BACKEND_BITBANG: setData/setClock/setLatch toggle the pins.
+ * SHIFT_REGISTER_BACKEND_SPI:     SPI0 shifts the pattern (MOSI PA1, SCK PA3)
+ *                                 and setLatch is still used for the latch.
+ */
+#define SHIFT_REGISTER_BACKEND_BITBANG  0
+#define SHIFT_REGISTER_BACKEND_SPI      1
+
+#ifndef SHIFT_REGISTER_BACKEND
+#define SHIFT_REGISTER_BACKEND SHIFT_REGISTER_BACKEND_BITBANG
+#endif
+
 
 void shifRegisterInit();
 void setData(bool bit);
@@ -24,13 +38,15 @@ void sendInt(bool state);
 void ADCMUXInit();
 void setChannel(uint8_t channel);
 void ADCInit();
-void timerInit();
 void enableGlobalInt();
 void waitTxReady(void);
 void USART0_oneWireInit(void);
 void USART0_oneWireSend(char* str, uint8_t size);
 void USART0_setBaudrate(uint32_t baud);
 void USART0_SetReceiveCompleteISR(bool val);
+void shiftRegisterSPIInit(void);
+void shiftRegisterSPIWrite(uint16_t value);
+void shiftRegisterSPIWait(void);
 
 
 
@@ -0,0 +1,25 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "hal_functions.h"
+
+void shiftRegisterSPIInit(void){
+    // MOSI and SCK as outputs, PA4 (SS) stays a normal pin since SSD is set
+    PORTA.DIRSET = PIN1_bm | PIN3_bm;
+    // buffered mode so the 2 bytes are written back to back, SS disabled, mode 0
+    SPI0.CTRLB = SPI_BUFEN_bm | SPI_SSD_bm | SPI_MODE_0_gc;
+    // LSB first like the bit bang backend, master, CLK_PER / 2
+    SPI0.CTRLA = SPI_DORD_bm | SPI_MASTER_bm | SPI_CLK2X_bm | SPI_PRESC_DIV4_gc | SPI_ENABLE_bm;
+}
+
+void shiftRegisterSPIWrite(uint16_t value){
+    SPI0.INTFLAGS = SPI_TXCIF_bm;
+    SPI0.DATA = value & 0xFF;
+    // the second byte can only be written once the first one left the buffer
+    while(!(SPI0.INTFLAGS & SPI_DREIF_bm));
+    SPI0.DATA = value >> 8;
+}
+
+void shiftRegisterSPIWait(void){
+    while(!(SPI0.INTFLAGS & SPI_TXCIF_bm));
+}
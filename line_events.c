@@ -0,0 +1,135 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+#include "line_events.h"
+
+// classes of a single scan
+typedef enum {
+    LINE_CLASS_NORMAL = 0,
+    LINE_CLASS_WIDE_BOTH,
+    LINE_CLASS_WIDE_LEFT,
+    LINE_CLASS_WIDE_RIGHT,
+    LINE_CLASS_ABSENT,
+} lineClass_t;
+
+lineClass_t candidateClass = LINE_CLASS_NORMAL;
+lineClass_t acceptedClass = LINE_CLASS_NORMAL;
+uint8_t candidateScans = 0;
+// consecutive scans without line and the length of the last absence
+uint8_t absentScans = 0;
+uint8_t lastAbsence = 0;
+// the end of the line was already reported for the current absence
+bool lineEndReported = false;
+lineEvent_t latchedEvent = LINE_EVENT_NONE;
+uint8_t eventCount = 0;
+
+/**
+ * @brief classifies the bitmap of a scan.
+ */
+static lineClass_t classifyScan(uint16_t bitmap, uint16_t mask, uint16_t scanMask){
+    bitmap &= mask;
+    if(bitmap == 0){
+        return LINE_CLASS_ABSENT;
+    }
+    uint8_t width = 0;
+    for(uint16_t aux = bitmap; aux != 0; aux &= aux - 1){
+        width++;
+    }
+    if(width <= LINE_EVENT_MAX_LINE_WIDTH){
+        return LINE_CLASS_NORMAL;
+    }
+    uint16_t left = scanMask & -scanMask;
+    uint16_t right = 0x8000;
+    while(right != 0 && !(scanMask & right)){
+        right >>= 1;
+    }
+    // an edge that was not scanned is not reached
+    bool leftEdge = (bitmap & left) != 0;
+    bool rightEdge = (bitmap & right) != 0;
+    if(leftEdge && rightEdge){
+        return LINE_CLASS_WIDE_BOTH;
+    }
+    if(leftEdge){
+        return LINE_CLASS_WIDE_LEFT;
+    }
+    if(rightEdge){
+        return LINE_CLASS_WIDE_RIGHT;
+    }
+    return LINE_CLASS_NORMAL;
+}
+
+/**
+ * @brief returns the event of a transition between accepted classes.
+ */
+static lineEvent_t classTransition(lineClass_t from, lineClass_t to, uint8_t gapFrames){
+    switch(to){
+        case LINE_CLASS_WIDE_LEFT:
+            return LINE_EVENT_BRANCH_LEFT;
+        case LINE_CLASS_WIDE_RIGHT:
+            return LINE_EVENT_BRANCH_RIGHT;
+        case LINE_CLASS_NORMAL:
+            if(from == LINE_CLASS_WIDE_BOTH){
+                return LINE_EVENT_INTERSECTION;
+            }
+            if(from == LINE_CLASS_ABSENT && lastAbsence <= gapFrames){
+                return LINE_EVENT_GAP;
+            }
+            return LINE_EVENT_NONE;
+        case LINE_CLASS_ABSENT:
+            if(from == LINE_CLASS_WIDE_BOTH){
+                lineEndReported = true;
+                return LINE_EVENT_T_JUNCTION;
+            }
+            return LINE_EVENT_NONE;
+        default:
+            return LINE_EVENT_NONE;
+    }
+}
+
+lineEvent_t lineEventUpdate(uint16_t bitmap, uint16_t mask, config_struct* cfgValues){
+    lineClass_t scanClass = classifyScan(bitmap, mask, cfgValues->scanMask);
+    lineEvent_t event = LINE_EVENT_NONE;
+    
+    if(scanClass == LINE_CLASS_ABSENT){
+        absentScans = absentScans < 0xFF ? absentScans + 1 : absentScans;
+        if(absentScans > cfgValues->eventGapFrames && !lineEndReported){
+            lineEndReported = true;
+            event = LINE_EVENT_LINE_LOST;
+        }
+    }else if(absentScans != 0){
+        lastAbsence = absentScans;
+        absentScans = 0;
+    }
+    
+    if(scanClass == candidateClass){
+        candidateScans = candidateScans < 0xFF ? candidateScans + 1 : candidateScans;
+    }else{
+        candidateClass = scanClass;
+        candidateScans = 1;
+    }
+    if(candidateScans == cfgValues->eventDebounce && candidateClass != acceptedClass){
+        lineEvent_t transition = classTransition(acceptedClass, candidateClass, cfgValues->eventGapFrames);
+        event = transition != LINE_EVENT_NONE ? transition : event;
+        acceptedClass = candidateClass;
+        if(acceptedClass == LINE_CLASS_NORMAL){
+            lineEndReported = false;
+        }
+    }
+    
+    if(event != LINE_EVENT_NONE){
+        latchedEvent = event;
+        eventCount++;
+    }
+    return event;
+}
+
+lineEvent_t lineEventRead(){
+    lineEvent_t event = latchedEvent;
+    latchedEvent = LINE_EVENT_NONE;
+    return event;
+}
+
+uint8_t lineEventCount(){
+    return eventCount;
+}
@@ -0,0 +1,85 @@
+/*
+ * File:                line_events.h
+ * Author:              Hector Manuel
+ * Comments:
+ * Revision history:
+ */
+
+
+#ifndef LINE_EVENTS_H
+#define	LINE_EVENTS_H
+
+/**
+ * @file line_events.h
+ *
+ * @brief detects features of the track from the binary values of the sensors.
+ *
+ * Every scan is classified from its bitmap (one bit per sensor) as a normal
+ * line, a wide line reaching both edges of the bar, a wide line reaching one
+ * edge or no line. A class must be seen in eventDebounce consecutive scans
+ * before it's accepted and the events are generated by the transitions
+ * between the accepted classes, so the master only needs to be woken up when
+ * the track changes. Sensor 0 is the left edge of the bar.
+ */
+
+#include <xc.h>
+#include "protocol_registers.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief sensors that can detect the line at the same time on a normal line,
+ * wider patterns are crossings or branches.
+ */
+#define LINE_EVENT_MAX_LINE_WIDTH       4
+
+/**
+ * @brief event codes reported by the line event register.
+ */
+typedef enum {
+    LINE_EVENT_NONE = 0,
+    LINE_EVENT_INTERSECTION,    /**< wide line on both sides and the line continues. */
+    LINE_EVENT_T_JUNCTION,      /**< wide line on both sides and the line ends. */
+    LINE_EVENT_BRANCH_LEFT,     /**< wide line reaching the sensor 0 edge. */
+    LINE_EVENT_BRANCH_RIGHT,    /**< wide line reaching the last sensor edge. */
+    LINE_EVENT_GAP,             /**< the line was missing up to eventGapFrames scans. */
+    LINE_EVENT_LINE_LOST,       /**< the line is missing for more than eventGapFrames scans. */
+} lineEvent_t;
+
+/**
+ * @brief classifies a completed scan and updates the event detector.
+ *
+ * @param[bitmap] binary value of the sensors, sensor 0 in bit 0.
+ * @param[mask] sensors scanned, the edges of the bar are the first and the
+ * last sensor of the scan mask, a scan that skipped them (region of interest)
+ * can't detect branches or crossings.
+ * @param[cfgValues] configuration with the debounce and gap settings.
+ *
+ * @return the event generated by this scan, LINE_EVENT_NONE most of the time.
+ */
+lineEvent_t lineEventUpdate(uint16_t bitmap, uint16_t mask, config_struct* cfgValues);
+
+/**
+ * @brief returns the last event and clears it.
+ *
+ * @return the latched event, LINE_EVENT_NONE if there was no event since the
+ * last call.
+ */
+lineEvent_t lineEventRead();
+
+/**
+ * @brief returns the amount of events detected, it wraps around at 255.
+ *
+ * @return the event counter.
+ */
+uint8_t lineEventCount();
+
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* LINE_EVENTS_H */
+
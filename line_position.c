@@ -0,0 +1,100 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+#include "line_position.h"
+#include "normalization.h"
+#include "scan_timer.h"
+
+linePosition_t lastLine = {
+    .position = ((IR_SENSOR_COUNT - 1) << 8) / 2,
+    .linePresent = false,
+    .contrast = 0,
+    .velocity = 0,
+    .acceleration = 0
+};
+
+// last positions and their timestamps, historyIndex is the newest entry
+uint16_t positionHistory[LINE_HISTORY_SIZE];
+uint32_t timeHistory[LINE_HISTORY_SIZE];
+uint8_t historyIndex = 0;
+uint8_t historyCount = 0;
+
+/**
+ * @brief returns the slope between two entries of the history in Q8.8
+ * sensors per ms saturated to 16 bits.
+ */
+static int16_t positionSlope(uint8_t from, uint8_t to){
+    uint32_t us = (timeHistory[to] - timeHistory[from]) / SCAN_TIMER_TICKS_PER_US;
+    if(us == 0){
+        return 0;
+    }
+    int32_t slope = (int32_t)((int16_t)(positionHistory[to] - positionHistory[from])) * 1000 / (int32_t)us;
+    return slope > INT16_MAX ? INT16_MAX : slope < INT16_MIN ? INT16_MIN : slope;
+}
+
+void updateLinePosition(IRSensor* sensors, uint16_t mask, linePosition_t* line){
+    uint16_t sum = 0;
+    uint32_t weighted = 0;
+    uint16_t min = 0xFFFF;
+    uint16_t max = 0;
+    bool linePresent = false;
+    
+    for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++, mask >>= 1){
+        if(!(mask & 1)){
+            continue;
+        }
+        uint16_t value = sensors[i].value;
+        uint16_t weight = normalizeValue(sensors, i);
+        sum += weight;
+        weighted += (uint16_t)(weight * i);
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+        linePresent |= sensors[i].procValue;
+    }
+    
+    line->linePresent = linePresent;
+    line->contrast = min > max ? 0 : (max - min) >> 2;
+    if(linePresent && sum != 0){
+        line->position = (weighted << 8) / sum;
+    }
+}
+
+void updateLineMotion(linePosition_t* line, uint32_t timestamp){
+    historyIndex = (historyIndex + 1) % LINE_HISTORY_SIZE;
+    positionHistory[historyIndex] = line->position;
+    timeHistory[historyIndex] = timestamp;
+    if(historyCount < LINE_HISTORY_SIZE){
+        historyCount++;
+        return;
+    }
+    uint8_t h0 = historyIndex;
+    uint8_t h1 = (historyIndex + LINE_HISTORY_SIZE - 1) % LINE_HISTORY_SIZE;
+    uint8_t h2 = (historyIndex + LINE_HISTORY_SIZE - 2) % LINE_HISTORY_SIZE;
+    uint8_t h3 = (historyIndex + LINE_HISTORY_SIZE - 3) % LINE_HISTORY_SIZE;
+    int16_t velocity = positionSlope(h2, h0);
+    int16_t previous = positionSlope(h3, h1);
+    // the slopes are centred half way in their intervals
+    uint32_t us = ((timeHistory[h0] - timeHistory[h1]) + (timeHistory[h2] - timeHistory[h3])) /
+                  (2 * SCAN_TIMER_TICKS_PER_US);
+    int32_t acceleration = us == 0 ? 0 : ((int32_t)velocity - previous) * 1000 / (int32_t)us;
+    line->velocity = velocity;
+    line->acceleration = acceleration > INT16_MAX ? INT16_MAX : acceleration < INT16_MIN ? INT16_MIN : acceleration;
+}
+
+uint16_t lineWindowMask(linePosition_t* line, uint8_t width){
+    if(width >= IR_SENSOR_COUNT){
+        return 0xFFFF;
+    }
+    // round the Q8.8 position to the closest sensor
+    uint8_t center = (line->position + 0x80) >> 8;
+    uint8_t first = center > width / 2 ? center - width / 2 : 0;
+    if(first + width > IR_SENSOR_COUNT){
+        first = IR_SENSOR_COUNT - width;
+    }
+    return (((uint16_t)1 << width) - 1) << first;
+}
+
+linePosition_t* getLinePosition(){
+    return &lastLine;
+}
@@ -0,0 +1,94 @@
+/*
+ * File:                line_position.h
+ * Author:              Hector Manuel
+ * Comments:
+ * Revision history:
+ */
+
+
+#ifndef LINE_POSITION_H
+#define	LINE_POSITION_H
+
+/**
+ * @file line_position.h
+ *
+ * @brief computes the position of the line from the sensor values.
+ */
+
+#include <xc.h>
+#include "protocol_registers.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief updates the line position with the values of a completed scan.
+ *
+ * Each sensor contributes with its normalized value (0 at the lower
+ * calibration, NORMALIZED_MAX at the upper one), the position is the weighted
+ * centroid of those weights. Only one 32/16 division is done per scan since
+ * the ATtiny404 has no hardware divider, the normalization uses precomputed
+ * reciprocals so the rest are additions, multiplications and shifts.
+ * 
+ * Approximate cost at -O2: ~60 cycles per sensor plus ~650 cycles for the
+ * division, around 1600 cycles (80us at 20MHz) for 16 sensors.
+ * 
+ * If no sensor detects the line the last position is kept so the master can
+ * tell to which side the line was lost.
+ *
+ * @param[sensors] sensors updated with the last scan.
+ * @param[mask] sensors that were scanned, the rest are ignored.
+ * @param[line] line position to update.
+ *
+ * @see linePosition_t
+ */
+void updateLinePosition(IRSensor* sensors, uint16_t mask, linePosition_t* line);
+
+/**
+ * @brief size of the history of positions used to calculate the motion.
+ */
+#define LINE_HISTORY_SIZE       4
+
+/**
+ * @brief updates the velocity and acceleration of the line with the position
+ * of the last scan and the time at which it was taken.
+ *
+ * The velocity is the slope over the last 2 scan intervals and the
+ * acceleration is the change between the last two of those slopes, using the
+ * real scan timestamps instead of the configured rate. 3 divisions are done
+ * per scan (~1800 cycles, 90us at 20MHz). When the line is lost the position
+ * is held so the velocity decays to 0.
+ *
+ * @param[line] line position updated with the last scan.
+ * @param[timestamp] completion time of the scan in TCB0 ticks.
+ *
+ * @see scanTimerGetTimestamp
+ */
+void updateLineMotion(linePosition_t* line, uint32_t timestamp);
+
+/**
+ * @brief returns a mask with a window of sensors centred on the line.
+ *
+ * @param[line] line position used as the centre of the window.
+ * @param[width] amount of sensors in the window, 1 to IR_SENSOR_COUNT, the
+ * window is moved to stay inside the bar near the edges.
+ *
+ * @return the window mask, one bit per sensor, sensor 0 in bit 0.
+ */
+uint16_t lineWindowMask(linePosition_t* line, uint8_t width);
+
+/**
+ * @brief returns the line position computed in the last scan.
+ *
+ * @return a pointer to the line position.
+ */
+linePosition_t* getLinePosition();
+
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* LINE_POSITION_H */
+
@@ -44,6 +44,8 @@
 #include "protocol_registers.h"
 #include "hal_functions.h"
 #include "state_machine.h"
+#include "scheduler.h"
+#include "event_loop.h"
 
 
 
@@ -63,58 +65,21 @@
 
 
 
-
-
-
-
-
-
-
-//volatile delayRequest delayRequests[MAX_DELAY_REQUESTS];
-
-
-//void ISRDelay(uint8_t ms, volatile bool* flag, void (*funPtr)(), uint8_t delayIndex){
-//    /*volatile delayRequest* slot = &delayRequests[delayIndex];
-//    slot->delay = ms;
-//    slot->flag = flag;
-//    slot->funPtr = funPtr;
-//    */
-//    delayRequests[delayIndex].delay = ms;
-//    delayRequests[delayIndex].flag = flag;
-//    delayRequests[delayIndex].funPtr = funPtr;
-//    //if(++delayIndex >= MAX_DELAY_REQUESTS){
-//    //    delayIndex = 0;
-//    //}
-//    
-//}
-
-
-
-
-
-
-
 int main(void)
 {   
     USART0_oneWireInit();
     shifRegisterInit();
+#if SHIFT_REGISTER_BACKEND == SHIFT_REGISTER_BACKEND_SPI
+    shiftRegisterSPIInit();
+#endif
     CLOCK_Initialize();
     ADCMUXInit();
     ADCInit();
-    //TIMER configuration
-    /* enable overflow interrupt */
-    //TCA0.SINGLE.INTCTRL = TCA_SINGLE_OVF_bm;
-    /* set Normal mode */
-    //TCA0.SINGLE.CTRLB = TCA_SINGLE_WGMODE_NORMAL_gc;
-    /* disable event counting */
-    //TCA0.SINGLE.EVCTRL &= ~(TCA_SINGLE_CNTEI_bm);
-    /* set the period */
-    //TCA0.SINGLE.PER = 300;  
-    //TCA0.SINGLE.CTRLA = TCA_SINGLE_CLKSEL_DIV64_gc;
     PORTA.DIR |= ISR_PIN;    
     /* Enable global interrupts */
     //sei();
-    timerInit();
+    schedulerInit();
+    eventLoopInit();
     enableGlobalInt();
     
     
@@ -124,9 +89,7 @@ int main(void)
     //USART0.CTRLA |= USART_RXCIE_bm;
     //ADC0.CTRLA |= ADC_ENABLE_bm;
     //volatile uint16_t* rawADCValues = getRawADCValues();
-    //volatile delayRequest* delayRequests = getDelayRequests();
     //IRSensor* sensors = getIrSensors();
-    //TCA0.SINGLE.CTRLA |= TCA_SINGLE_ENABLE_bm;
     
     //config_struct* cfgValues = getConfig();
     //char* tx = getTxBuffer();
@@ -143,5 +106,7 @@ int main(void)
     while (1) 
     {   
         updateStateMachine();
+        // sleeps until an ISR posts the next event
+        eventWait();
     }
 }
\ No newline at end of file
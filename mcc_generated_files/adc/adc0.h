@@ -165,6 +165,15 @@ void ADC0_StartConversion(adc_0_channel_t channel);
  */
 bool ADC0_IsConversionDone(void);
 
+/**
+ * @ingroup adc0
+ * @brief Checks if an ADC conversion is in progress, started by software or by an event
+ * @param none
+ * @retval 1 (true) - A conversion is in progress
+ * @retval 0 (false) - The ADC is idle
+ */
+bool ADC0_IsConversionRunning(void);
+
 /**
  * @ingroup adc0
  * @brief Reads a conversion result from ADC0
@@ -190,6 +199,46 @@ bool ADC0_GetWindowResult(void);
  */
 adc_result_t ADC0_GetConversion(adc_0_channel_t channel);
 
+/**
+ * @ingroup adc0
+ * @brief Sets the number of samples accumulated in each conversion result
+ * @param uint8_t sampnum - log2 of the number of samples, 0 (1 sample) to 6 (64 samples)
+ * @return none
+ */
+void ADC0_SetSampleAccumulation(uint8_t sampnum);
+
+/**
+ * @ingroup adc0
+ * @brief Sets the ADC clock prescaler
+ * @param uint8_t presc - CLK_PER is divided by 2 << presc (0 to 7)
+ * @return none
+ */
+void ADC0_SetPrescaler(uint8_t presc);
+
+/**
+ * @ingroup adc0
+ * @brief Sets the extra sampling time of every conversion
+ * @param uint8_t samplen - ADC clock cycles added to the sampling time (0 to 31)
+ * @return none
+ */
+void ADC0_SetSampleLength(uint8_t samplen);
+
+/**
+ * @ingroup adc0
+ * @brief Sets the delay before the first conversion after the ADC is enabled
+ * @param uint8_t initdly - delay of 16 << (initdly - 1) ADC clock cycles, 0 for no delay (0 to 5)
+ * @return none
+ */
+void ADC0_SetInitDelay(uint8_t initdly);
+
+/**
+ * @ingroup adc0
+ * @brief Sets the resolution of the conversion result
+ * @param uint8_t bits - 8 for 8-bit mode, any other value selects 10-bit mode
+ * @return none
+ */
+void ADC0_SetResolution(uint8_t bits);
+
 /**
  * @ingroup adc0
  * @brief Returns the number of bits in the ADC conversion result
@@ -134,6 +134,11 @@ bool ADC0_IsConversionDone(void)
     return (ADC0.INTFLAGS & ADC_RESRDY_bm);
 }
 
+bool ADC0_IsConversionRunning(void)
+{
+    return (ADC0.COMMAND & ADC_STCONV_bm);
+}
+
 adc_result_t ADC0_GetConversionResult(void)
 {
     return (ADC0.RES);
@@ -157,9 +162,34 @@ adc_result_t ADC0_GetConversion(adc_0_channel_t channel)
     return res;
 }
 
+void ADC0_SetSampleAccumulation(uint8_t sampnum)
+{
+    ADC0.CTRLB = sampnum & ADC_SAMPNUM_gm;
+}
+
+void ADC0_SetPrescaler(uint8_t presc)
+{
+    ADC0.CTRLC = (ADC0.CTRLC & ~ADC_PRESC_gm) | (presc & ADC_PRESC_gm);
+}
+
+void ADC0_SetSampleLength(uint8_t samplen)
+{
+    ADC0.SAMPCTRL = samplen & ADC_SAMPLEN_gm;
+}
+
+void ADC0_SetInitDelay(uint8_t initdly)
+{
+    ADC0.CTRLD = (ADC0.CTRLD & ~ADC_INITDLY_gm) | ((initdly << ADC_INITDLY_gp) & ADC_INITDLY_gm);
+}
+
+void ADC0_SetResolution(uint8_t bits)
+{
+    ADC0.CTRLA = (bits == 8) ? (ADC0.CTRLA | ADC_RESSEL_bm) : (ADC0.CTRLA & ~ADC_RESSEL_bm);
+}
+
 uint8_t ADC0_GetResolution(void)
 {
-    return (ADC0.CTRLA & ADC_RESSEL_bm) ? 10 : 12;
+    return (ADC0.CTRLA & ADC_RESSEL_bm) ? 8 : 10;
 }
 
 void ADC0_RegisterWindowCallback(adc_irq_cb_t f)
@@ -0,0 +1,40 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+#include "normalization.h"
+
+// largest span of a 10 bit value
+#define NORMALIZATION_MAX_SPAN      0x3FF
+
+// Q6.10 scale factors, NORMALIZED_MAX / span
+uint16_t normalizationScale[IR_SENSOR_COUNT];
+
+/**
+ * @brief returns the calibrated span of a sensor limited to the range where
+ * the scale factor is valid.
+ */
+static uint16_t normalizationSpan(IRSensor* sensor){
+    uint16_t span = sensor->upper > sensor->lower ? sensor->upper - sensor->lower : 0;
+    if(span > NORMALIZATION_MAX_SPAN){
+        return NORMALIZATION_MAX_SPAN;
+    }
+    return span < NORMALIZATION_MIN_SPAN ? NORMALIZATION_MIN_SPAN : span;
+}
+
+void updateNormalization(IRSensor* sensors){
+    for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
+        uint16_t span = normalizationSpan(&sensors[i]);
+        normalizationScale[i] = (((uint32_t)NORMALIZED_MAX << 10) + (span >> 1)) / span;
+    }
+}
+
+uint16_t normalizeValue(IRSensor* sensors, uint8_t index){
+    uint16_t value = sensors[index].value;
+    uint16_t lower = sensors[index].lower;
+    if(value <= lower){
+        return 0;
+    }
+    uint16_t normalized = ((uint32_t)(value - lower) * normalizationScale[index]) >> 10;
+    return normalized > NORMALIZED_MAX ? NORMALIZED_MAX : normalized;
+}
@@ -0,0 +1,70 @@
+/*
+ * File:                normalization.h
+ * Author:              Hector Manuel
+ * Comments:
+ * Revision history:
+ */
+
+
+#ifndef NORMALIZATION_H
+#define	NORMALIZATION_H
+
+/**
+ * @file normalization.h
+ *
+ * @brief scales the sensor values to a common range using their calibration.
+ *
+ * The ATtiny404 has no hardware divider, so a reciprocal of the calibrated
+ * span of every sensor is calculated only when the calibration changes and
+ * the values of every scan are normalized with a multiplication and a shift.
+ */
+
+#include <xc.h>
+#include "protocol_registers.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief normalized value of a sensor at or above its upper threshold.
+ */
+#define NORMALIZED_MAX              1000
+
+/**
+ * @brief spans (upper - lower) below this are treated as this value so the
+ * reciprocal fits in 16 bits.
+ */
+#define NORMALIZATION_MIN_SPAN      16
+
+/**
+ * @brief calculates the scale factor of every sensor from its calibration,
+ * this must be called every time upper or lower change.
+ *
+ * The factor is (NORMALIZED_MAX << 10) / span in Q6.10, one 32/16 division
+ * per sensor (~250 cycles each).
+ *
+ * @param[sensors] calibrated sensors.
+ */
+void updateNormalization(IRSensor* sensors);
+
+/**
+ * @brief returns the value of a sensor scaled between its lower (0) and upper
+ * (NORMALIZED_MAX) thresholds, values outside are saturated.
+ *
+ * Only a 16x16 multiplication and a shift are needed.
+ *
+ * @param[sensors] sensors updated with the last scan.
+ * @param[index] sensor to normalize, lower than IR_SENSOR_COUNT.
+ *
+ * @return the normalized value, 0 to NORMALIZED_MAX.
+ */
+uint16_t normalizeValue(IRSensor* sensors, uint8_t index);
+
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* NORMALIZATION_H */
+
@@ -2,6 +2,30 @@
 #include "protocol_registers.h"
 #include "hal_functions.h"
 #include "config.h"
+#include "mcc_generated_files/adc/adc0.h"
+#include "scan_timer.h"
+#include "calibration.h"
+#include "settings_storage.h"
+#include "normalization.h"
+#include "line_events.h"
+#include "state_machine.h"
+#include "mcc_generated_files/system/utils/atomic.h"
+#include "scheduler.h"
+#include "event_loop.h"
+
+// ADC clock cycles of one sample (2 sampling + 13 conversion) with SAMPLEN = 0
+#define ADC_SAMPLE_CYCLES           15
+// approximate CPU cycles spent per channel outside the ADC (ISR, shift register
+// selection and conversion start)
+#if SHIFT_REGISTER_BACKEND == SHIFT_REGISTER_BACKEND_SPI
+#define SCAN_CHANNEL_OVERHEAD_CYCLES 200
+#elif SHIFT_REGISTER_SEQUENTIAL
+#define SCAN_CHANNEL_OVERHEAD_CYCLES 250
+#else
+#define SCAN_CHANNEL_OVERHEAD_CYCLES 1000
+#endif
+// log2 of the maximum amount of accumulated samples supported by the ADC
+#define ADC_MAX_ACCUMULATION        6
 
 
 //TODO implement better default values
@@ -19,7 +43,26 @@ config_struct cfgValues = {
     .txDelay = 5,
     .enableCRC = true,
     .acumulator = 0,
-    .baudrate = BAUDRATE_115200
+    .baudrate = BAUDRATE_115200,
+    .streamEnable = false,
+    .settleTime = 0,
+    .windowCompare = false,
+    .resolution8Bit = false,
+    // same timing as ADC0_Initialize, DIV2 and DLY256
+    .adcPrescaler = 0,
+    .adcSampleLength = 0,
+    .adcInitDelay = 5,
+    .filterShift = 0,
+    .eventEnable = false,
+    .eventDebounce = 2,
+    .eventGapFrames = 10,
+    .intOnChange = false,
+    .intPositionDelta = 0x40,
+    .protocolVersion = PROTOCOL_VERSION_LEGACY,
+    .scanPeriod = 0,
+    .scanMask = 0xFFFF,
+    .roiWidth = 0,
+    .roiFullScanInterval = 8
 };
 
 
@@ -61,14 +104,18 @@ bool registerConfig(char reg, volatile char* msg, char* response, IRSensor* sens
         cfgValues.txDelay = msg[1];
         cfgValues.enable = msg[2] & 0x01;
         cfgValues.enableCRC = (msg[2] & 0x02) >> 1;
-        cfgValues.acumulator = (msg[2] & 0x0C) >> 2;
+        cfgValues.acumulator = (msg[2] & 0x1C) >> 2;
+        if(cfgValues.acumulator > ADC_MAX_ACCUMULATION){
+            cfgValues.acumulator = ADC_MAX_ACCUMULATION;
+        }
         if(getDecodedBaudrate(msg[3]) != 0){
-            cfgValues.baudrate = getDecodedBaudrate(msg[3]);
-            USART0_setBaudrate(cfgValues.baudrate);
+            cfgValues.baudrate = msg[3];
+            USART0_setBaudrate(getDecodedBaudrate(cfgValues.baudrate));
         }
         
-        if(cfgValues.enable){
-            ADCStartConversion();
+        if(cfgValues.enable && scanTimerGetPeriod() == 0){
+            // with the scan timer the scans are started by hardware
+            startScan();
         }
         result = false;
     }
@@ -83,12 +130,14 @@ bool registerStatus(char reg, volatile char* msg, char *response, IRSensor* sens
     if(isReadOperation(reg)){
         uint16_t binaryDataSensors = 0;
         for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
-            binaryDataSensors |= sensors[i].value << i;
+            binaryDataSensors |= (uint16_t)sensors[i].procValue << i;
         }
-        response[0] = binaryDataSensors & 0x00FF >> 0x00;
-        response[1] = binaryDataSensors & 0xFF00 >> 0x08;
-        response[2] = 0;
-        response[3] = 0;
+        uint16_t frameMask = getFrameMask();
+        binaryDataSensors &= frameMask;
+        response[0] = binaryDataSensors & 0xFF;
+        response[1] = binaryDataSensors >> 8;
+        response[2] = frameMask & 0xFF;
+        response[3] = frameMask >> 8;
         return true;
     }
     return false;
@@ -116,6 +165,69 @@ bool registerRawIRDataBlockX(char reg, volatile char* msg, char* response, block
 }
 
 
+bool registerNormalizedAll(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        for(uint8_t i = 0; i < RAW_DATA_ALL_SIZE; i++){
+            response[i] = 0;
+        }
+        uint16_t frameMask = getFrameMask();
+        for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
+            // the sensors skipped by the scan keep reporting the masked value,
+            // a saturated sensor has the same raw value so the mask is used
+            bool masked = !((frameMask >> i) & 1);
+            pack10BitValue(response, i, masked ? IR_SENSOR_MASKED_VALUE : normalizeValue(sensors, i));
+        }
+        return true;
+    }
+    return false;
+}
+
+
+bool registerRaw8IRDataBlockX(char reg, volatile char* msg, char* response, block8_t block, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        for(uint8_t i = 0; i < 4; i++){
+            response[i] = (sensors[block+i].value & 0x3FF) >> 2;
+        }
+        return true;
+    }
+    return false;
+}
+
+
+bool registerRaw8IRDataAll(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        for(uint8_t i = 0; i < RAW8_DATA_ALL_SIZE; i++){
+            response[i] = (sensors[i].value & 0x3FF) >> 2;
+        }
+        return true;
+    }
+    return false;
+}
+
+
+void pack10BitValue(char* response, uint8_t index, uint16_t value){
+    uint16_t bit = (uint16_t)index * 10;
+    uint16_t aux = (value & 0x3FF) << (bit & 0x07);
+    response += bit >> 3;
+    response[0] |= aux & 0xFF;
+    response[1] |= aux >> 8;
+}
+
+
+bool registerRawIRDataAll(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        for(uint8_t i = 0; i < RAW_DATA_ALL_SIZE; i++){
+            response[i] = 0;
+        }
+        for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
+            pack10BitValue(response, i, sensors[i].value);
+        }
+        return true;
+    }
+    return false;
+}
+
+
 bool registerUpperCalibblockX(char reg, volatile char* msg, char* response, block_t block, IRSensor* sensors){
     if(isReadOperation(reg)){
     uint32_t aux =
@@ -134,9 +246,10 @@ bool registerUpperCalibblockX(char reg, volatile char* msg, char* response, bloc
         return true;
     }
     uint32_t values = array2int(msg);
-    sensors[block].upper = values & 0x3FF >> 0;
-    sensors[block+1].upper = values & ((uint32_t)0x3FF << 10) >> 10;
-    sensors[block+2].upper = values & ((uint32_t)0x3FF << 20) >> 20;
+    sensors[block].upper = (values >> 0) & 0x3FF;
+    sensors[block+1].upper = (values >> 10) & 0x3FF;
+    sensors[block+2].upper = (values >> 20) & 0x3FF;
+    updateNormalization(sensors);
     return true;
 }
 
@@ -156,12 +269,357 @@ bool registerLowerCalibblockX(char reg, volatile char* msg, char* response, bloc
         return true;
     }
     uint32_t values = array2int(msg);
-    sensors[block].lower = values & 0x3FF >> 0;
-    sensors[block+1].lower = values & ((uint32_t)0x3FF << 10) >> 10;
-    sensors[block+2].lower = values & ((uint32_t)0x3FF << 20) >> 20;
+    sensors[block].lower = (values >> 0) & 0x3FF;
+    sensors[block+1].lower = (values >> 10) & 0x3FF;
+    sensors[block+2].lower = (values >> 20) & 0x3FF;
+    updateNormalization(sensors);
+    return true;
+}
+
+bool registerStream(char reg, volatile char* msg, char* response, uint8_t sequence){
+    if(isReadOperation(reg)){
+        response[0] = cfgValues.streamEnable;
+        response[1] = sequence;
+        response[2] = 0;
+        response[3] = 0;
+        return true;
+    }
+    cfgValues.streamEnable = msg[0] & 0x01;
+    return false;
+}
+
+/**
+ * @brief returns the sampling time added to every conversion, the sample
+ * length plus the settle time saturated to the SAMPLEN field.
+ */
+static uint8_t getSampleLength(){
+    uint8_t length = cfgValues.adcSampleLength + cfgValues.settleTime;
+    return length > ADC_MAX_SAMPLE_LENGTH ? ADC_MAX_SAMPLE_LENGTH : length;
+}
+
+uint16_t getFrameRate(){
+    uint16_t prescaler = (uint16_t)2 << cfgValues.adcPrescaler;
+    uint32_t channelCycles = ((uint32_t)(ADC_SAMPLE_CYCLES + getSampleLength()) * prescaler << cfgValues.acumulator) +
+                             SCAN_CHANNEL_OVERHEAD_CYCLES;
+    uint8_t channels = 0;
+    for(uint16_t mask = cfgValues.scanMask; mask != 0; mask >>= 1){
+        channels += mask & 1;
+    }
+    uint32_t frameUs = channelCycles * channels / (F_CPU / 1000000UL);
+    if(scanTimerGetPeriod() != 0){
+        // hardware timed, the period is fixed unless the scan is longer
+        frameUs = frameUs > scanTimerGetPeriod() ? frameUs : scanTimerGetPeriod();
+    }else{
+        frameUs += (uint32_t)cfgValues.sampleRate * 1000;
+    }
+    return 1000000UL / frameUs;
+}
+
+
+bool registerFrameRate(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        uint16_t fps = getFrameRate();
+        response[0] = fps & 0xFF;
+        response[1] = fps >> 8;
+        response[2] = cfgValues.acumulator;
+        response[3] = 0;
+        return true;
+    }
+    return false;
+}
+
+
+bool registerScanTimer(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        uint16_t period = scanTimerGetPeriod();
+        uint16_t jitter = scanTimerGetJitter();
+        response[0] = period & 0xFF;
+        response[1] = period >> 8;
+        response[2] = jitter & 0xFF;
+        response[3] = jitter >> 8;
+        return true;
+    }
+    cfgValues.scanPeriod = (uint8_t)msg[0] | (uint16_t)(uint8_t)msg[1] << 8;
+    applyScanPeriod();
+    return false;
+}
+
+
+bool registerScanConfig(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        response[0] = cfgValues.settleTime;
+        response[1] = cfgValues.windowCompare | (cfgValues.resolution8Bit << 1);
+        response[2] = cfgValues.filterShift;
+        response[3] = 0;
+        return true;
+    }
+    cfgValues.settleTime = msg[0] > SCAN_MAX_SETTLE_TIME ? SCAN_MAX_SETTLE_TIME : msg[0];
+    ADC0_SetSampleLength(getSampleLength());
+    cfgValues.windowCompare = msg[1] & 0x01;
+    cfgValues.resolution8Bit = (msg[1] & 0x02) >> 1;
+    cfgValues.filterShift = (uint8_t)msg[2] > FILTER_MAX_SHIFT ? FILTER_MAX_SHIFT : msg[2];
+    return false;
+}
+
+
+bool registerADCTiming(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        response[0] = cfgValues.adcPrescaler;
+        response[1] = cfgValues.adcSampleLength;
+        response[2] = cfgValues.adcInitDelay;
+        response[3] = 0;
+        return true;
+    }
+    cfgValues.adcPrescaler = (uint8_t)msg[0] > ADC_MAX_PRESCALER ? ADC_MAX_PRESCALER : msg[0];
+    cfgValues.adcSampleLength = (uint8_t)msg[1] > ADC_MAX_SAMPLE_LENGTH ? ADC_MAX_SAMPLE_LENGTH : msg[1];
+    cfgValues.adcInitDelay = (uint8_t)msg[2] > ADC_MAX_INIT_DELAY ? ADC_MAX_INIT_DELAY : msg[2];
+    ADC0_SetPrescaler(cfgValues.adcPrescaler);
+    ADC0_SetSampleLength(getSampleLength());
+    return false;
+}
+
+
+bool registerADCMeasurement(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        uint16_t channelTime = scanTimerGetChannelTime();
+        uint32_t frameUs = scanTimerGetScanTime() / SCAN_TIMER_TICKS_PER_US;
+        if(scanTimerGetPeriod() != 0){
+            frameUs = frameUs > scanTimerGetPeriod() ? frameUs : scanTimerGetPeriod();
+        }else{
+            frameUs += (uint32_t)cfgValues.sampleRate * 1000;
+        }
+        uint16_t fps = frameUs == 0 ? 0 : 1000000UL / frameUs;
+        response[0] = channelTime & 0xFF;
+        response[1] = channelTime >> 8;
+        response[2] = fps & 0xFF;
+        response[3] = fps >> 8;
+        return true;
+    }
+    return false;
+}
+
+
+bool registerAutoCalibration(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        uint8_t upperMargin, lowerMargin;
+        calibrationGetMargins(&upperMargin, &lowerMargin);
+        response[0] = calibrationRemainingScans();
+        response[1] = upperMargin;
+        response[2] = lowerMargin;
+        response[3] = calibrationRunning();
+        return true;
+    }
+    calibrationStart(sensors, cfgValues.scanMask, msg[0], msg[1], msg[2]);
+    return false;
+}
+
+
+void applyConfig(){
+    if(getDecodedBaudrate(cfgValues.baudrate) != 0){
+        USART0_setBaudrate(getDecodedBaudrate(cfgValues.baudrate));
+    }
+    ADC0_SetPrescaler(cfgValues.adcPrescaler);
+    ADC0_SetSampleLength(getSampleLength());
+}
+
+
+void applyScanPeriod(){
+    scanTimerSetPeriod(cfgValues.scanPeriod);
+    // the period is saturated by the scan timer
+    cfgValues.scanPeriod = scanTimerGetPeriod();
+    if(cfgValues.scanPeriod != 0){
+        // a pending software delay would start a scan out of the period
+        cancelScanDelay();
+    }else if(cfgValues.enable){
+        // nothing schedules the next software scan until one completes
+        startScan();
+    }
+}
+
+
+bool loadSettings(IRSensor* sensors){
+    if(!settingsLoad(&cfgValues, sensors)){
+        return false;
+    }
+    updateNormalization(sensors);
+    cfgValues.streamEnable = false;
     return true;
 }
 
+
+uint8_t settingsCommand = 0;
+bool settingsResult = false;
+
+bool registerSettings(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        response[0] = settingsCommand;
+        response[1] = settingsResult;
+        response[2] = settingsValid();
+        response[3] = 0;
+        return true;
+    }
+    settingsCommand = msg[0];
+    switch(settingsCommand){
+        case SETTINGS_CMD_SAVE:
+            settingsResult = settingsSave(&cfgValues, sensors);
+            break;
+        case SETTINGS_CMD_LOAD:
+            settingsResult = loadSettings(sensors);
+            if(settingsResult){
+                applyConfig();
+                applyScanPeriod();
+            }
+            break;
+        case SETTINGS_CMD_ERASE:
+            settingsErase();
+            settingsResult = !settingsValid();
+            break;
+        default:
+            settingsResult = false;
+    }
+    return false;
+}
+
+
+bool registerLineEvent(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        response[0] = lineEventRead();
+        response[1] = lineEventCount();
+        response[2] = cfgValues.eventDebounce | (cfgValues.eventEnable << 7);
+        response[3] = cfgValues.eventGapFrames;
+        return true;
+    }
+    cfgValues.eventDebounce = msg[2] & 0x7F;
+    if(cfgValues.eventDebounce == 0){
+        cfgValues.eventDebounce = 1;
+    }
+    cfgValues.eventEnable = (msg[2] & 0x80) >> 7;
+    cfgValues.eventGapFrames = msg[3];
+    return false;
+}
+
+
+bool registerInterrupt(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        response[0] = readInterruptCause();
+        response[1] = cfgValues.intOnChange;
+        response[2] = cfgValues.intPositionDelta & 0xFF;
+        response[3] = cfgValues.intPositionDelta >> 8;
+        return true;
+    }
+    cfgValues.intOnChange = msg[1] & 0x01;
+    cfgValues.intPositionDelta = (uint8_t)msg[2] | (uint16_t)(uint8_t)msg[3] << 8;
+    return false;
+}
+
+
+bool registerScanMask(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        uint16_t frameMask = getFrameMask();
+        response[0] = cfgValues.scanMask & 0xFF;
+        response[1] = cfgValues.scanMask >> 8;
+        response[2] = frameMask & 0xFF;
+        response[3] = frameMask >> 8;
+        return true;
+    }
+    uint16_t mask = (uint8_t)msg[0] | (uint16_t)(uint8_t)msg[1] << 8;
+    if(mask != 0){
+        ENTER_CRITICAL(scanMaskUpdate);
+        cfgValues.scanMask = mask;
+        EXIT_CRITICAL(scanMaskUpdate);
+    }
+    return false;
+}
+
+
+bool registerROI(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        response[0] = cfgValues.roiWidth;
+        response[1] = cfgValues.roiFullScanInterval;
+        response[2] = 0;
+        response[3] = 0;
+        return true;
+    }
+    cfgValues.roiWidth = msg[0] > IR_SENSOR_COUNT ? IR_SENSOR_COUNT : msg[0];
+    cfgValues.roiFullScanInterval = msg[1];
+    return false;
+}
+
+
+bool registerLinePosition(char reg, volatile char* msg, char* response, linePosition_t* line){
+    if(isReadOperation(reg)){
+        response[0] = line->position & 0xFF;
+        response[1] = line->position >> 8;
+        response[2] = line->linePresent;
+        response[3] = line->contrast;
+        return true;
+    }
+    return false;
+}
+
+bool registerLineVelocity(char reg, volatile char* msg, char* response, linePosition_t* line){
+    if(isReadOperation(reg)){
+        response[0] = (uint16_t)line->velocity & 0xFF;
+        response[1] = (uint16_t)line->velocity >> 8;
+        response[2] = (uint16_t)line->acceleration & 0xFF;
+        response[3] = (uint16_t)line->acceleration >> 8;
+        return true;
+    }
+    return false;
+}
+
+bool registerProtocol(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        response[0] = cfgValues.protocolVersion;
+        response[1] = 0;
+        response[2] = 0;
+        response[3] = 0;
+        return true;
+    }
+    if(msg[0] == PROTOCOL_VERSION_LEGACY || msg[0] == PROTOCOL_VERSION_BIT_TIMES){
+        cfgValues.protocolVersion = msg[0];
+    }
+    return false;
+}
+
+// event source reported by the event latency register
+uint8_t latencySource = EVENT_DATAGRAM;
+
+/**
+ * @brief converts scheduler ticks to microseconds saturated to 16 bits.
+ */
+static uint16_t ticksToUs(uint16_t ticks){
+    uint32_t us = (uint32_t)ticks * 1000 / SCHEDULER_TICKS_PER_MS;
+    return us > 0xFFFF ? 0xFFFF : us;
+}
+
+bool registerEventLatency(char reg, volatile char* msg, char* response, IRSensor* sensors){
+    if(isReadOperation(reg)){
+        eventLatency_t latency;
+        eventGetLatency(latencySource, &latency);
+        uint16_t last = ticksToUs(latency.last);
+        uint16_t max = ticksToUs(latency.max);
+        response[0] = last & 0xFF;
+        response[1] = last >> 8;
+        response[2] = max & 0xFF;
+        response[3] = max >> 8;
+        return true;
+    }
+    if(msg[0] < EVENT_SOURCE_COUNT){
+        latencySource = msg[0];
+    }
+    if(msg[1] != 0){
+        eventClearLatency();
+    }
+    return false;
+}
+
+uint32_t getTxDelayTicks(){
+    // the USART BAUD register is 4 * CLK_PER / baudrate and the scheduler runs
+    // at CLK_PER / 16, so a bit time is BAUD / 64 ticks
+    return ((uint32_t)cfgValues.txDelay * getDecodedBaudrate(cfgValues.baudrate) + 63) / 64;
+}
+
 config_struct* getConfig(){
     return &cfgValues;
 }
\ No newline at end of file
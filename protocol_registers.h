@@ -23,6 +23,119 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/**
+ * @brief registers added on top of the ones in config.h, the address is the
+ * register number without the r/w bit.
+ */
+#define LS_REGISTER_RAW_DATA_ALL        0x20
+#define LS_REGISTER_STREAM              0x21
+#define LS_REGISTER_LINE_POSITION       0x22
+#define LS_REGISTER_FRAME_RATE          0x23
+#define LS_REGISTER_SCAN_TIMER          0x24
+#define LS_REGISTER_SCAN_CONFIG         0x25
+#define LS_REGISTER_SCAN_MASK           0x26
+#define LS_REGISTER_ROI                 0x27
+#define LS_REGISTER_RAW8_DATA_0         0x28
+#define LS_REGISTER_RAW8_DATA_1         0x29
+#define LS_REGISTER_RAW8_DATA_2         0x2A
+#define LS_REGISTER_RAW8_DATA_3         0x2B
+#define LS_REGISTER_RAW8_DATA_ALL       0x2C
+#define LS_REGISTER_ADC_TIMING          0x2D
+#define LS_REGISTER_ADC_MEASUREMENT     0x2E
+#define LS_REGISTER_AUTO_CALIBRATION    0x2F
+#define LS_REGISTER_SETTINGS            0x30
+#define LS_REGISTER_NORMALIZED_ALL      0x31
+#define LS_REGISTER_LINE_EVENT          0x32
+#define LS_REGISTER_INTERRUPT           0x33
+#define LS_REGISTER_LINE_VELOCITY       0x34
+#define LS_REGISTER_PROTOCOL            0x35
+#define LS_REGISTER_EVENT_LATENCY       0x36
+
+/**
+ * @brief protocol versions, they change the meaning of txDelay.
+ * 
+ * PROTOCOL_VERSION_LEGACY:    txDelay in milliseconds from the moment the
+ *                             request is processed.
+ * PROTOCOL_VERSION_BIT_TIMES: txDelay in bit times of the current baudrate
+ *                             from the end of the request, 0 replies as soon
+ *                             as the response is ready.
+ */
+#define PROTOCOL_VERSION_LEGACY         0
+#define PROTOCOL_VERSION_BIT_TIMES      1
+
+/**
+ * @brief causes of the interrupt reported by the interrupt register, they
+ * are accumulated until the register is read.
+ */
+#define INT_CAUSE_SCAN                  0x01
+#define INT_CAUSE_BITMAP                0x02
+#define INT_CAUSE_POSITION              0x04
+#define INT_CAUSE_EVENT                 0x08
+#define INT_CAUSE_CALIBRATION           0x10
+
+/**
+ * @brief commands of the settings register.
+ */
+#define SETTINGS_CMD_SAVE               0x01
+#define SETTINGS_CMD_LOAD               0x02
+#define SETTINGS_CMD_ERASE              0x03
+
+/**
+ * @brief value reported for the sensors skipped by the last scan (scan mask
+ * or region of interest).
+ * 
+ * It's also a valid full scale reading, the frame mask returned by the scan
+ * mask register tells if a sensor was skipped, not the value.
+ */
+#define IR_SENSOR_MASKED_VALUE          0x3FF
+
+/**
+ * @brief maximum settle time, it's added to the ADC sampling time (SAMPLEN).
+ */
+#define SCAN_MAX_SETTLE_TIME            15
+
+/**
+ * @brief maximum values of the ADC timing register fields, the prescaler
+ * divides CLK_PER by 2 << adcPrescaler and the init delay is
+ * 16 << (adcInitDelay - 1) ADC clock cycles.
+ */
+#define ADC_MAX_PRESCALER               7
+#define ADC_MAX_SAMPLE_LENGTH           31
+#define ADC_MAX_INIT_DELAY              5
+
+/**
+ * @brief strongest low pass filter, alpha = 1 / (1 << FILTER_MAX_SHIFT).
+ */
+#define FILTER_MAX_SHIFT                6
+
+/**
+ * @brief size of the payload of the bulk raw data register, 16 values of 10
+ * bits packed back to back.
+ */
+#define RAW_DATA_ALL_SIZE               20
+
+/**
+ * @brief size of the payload of the 8 bit bulk raw data register, one byte
+ * per sensor.
+ */
+#define RAW8_DATA_ALL_SIZE              16
+
+/**
+ * @brief response sizes, the fixed size response has 3 header bytes, 4 bytes
+ * of data and the CRC, the bulk response carries RAW_DATA_ALL_SIZE bytes of
+ * data instead.
+ */
+#define DATAGRAM_RESPONSE_SIZE          8
+#define DATAGRAM_BULK_RESPONSE_SIZE     (3 + RAW_DATA_ALL_SIZE + 1)
+#define DATAGRAM_BULK8_RESPONSE_SIZE    (3 + RAW8_DATA_ALL_SIZE + 1)
+
+/**
+ * @brief size of a frame sent in streaming mode, 3 header bytes, the sequence
+ * number, the frame mask, the packed raw values and the CRC.
+ */
+#define DATAGRAM_STREAM_SIZE            (3 + 1 + 2 + RAW_DATA_ALL_SIZE + 1)
+#define DATAGRAM_MAX_RESPONSE_SIZE      DATAGRAM_STREAM_SIZE
+
 /**
  * @struct IRSensor
  *
@@ -39,6 +152,25 @@ typedef struct {
     uint16_t lower;  /**< The lower threshold value for the infrared sensor's data. */
 } IRSensor;
 
+/**
+ * @struct linePosition_t
+ *
+ * @brief Represents the position of the line under the sensor bar.
+ *
+ * The position is the weighted centroid of the calibrated sensor values in
+ * Q8.8 format, the integer part is the index of the sensor so the range goes
+ * from 0 (sensor 0) to (IR_SENSOR_COUNT - 1) << 8. The velocity and the
+ * acceleration use the same Q8.8 sensor units per ms and per ms^2, so
+ * 0x0100 is one sensor per ms (saturated to +-128 sensors per ms).
+ */
+typedef struct {
+    uint16_t position;   /**< centroid of the line, Q8.8 sensor index. */
+    bool linePresent;    /**< true if at least one sensor detects the line. */
+    uint8_t contrast;    /**< (max - min) / 4 of the frame, saturated to 255. */
+    int16_t velocity;    /**< Q8.8 sensors per ms. */
+    int16_t acceleration;/**< Q8.8 sensors per ms^2. */
+} linePosition_t;
+
 // TODO: validate all baudrates
 /**
  * @struct baudrate_t
@@ -69,6 +201,24 @@ typedef struct {
     bool enableCRC: 1;
     uint8_t acumulator: 6;
     baudrate_t baudrate; 
+    bool streamEnable;
+    uint8_t settleTime;
+    bool windowCompare;
+    bool resolution8Bit;
+    uint8_t adcPrescaler;
+    uint8_t adcSampleLength;
+    uint8_t adcInitDelay;
+    uint8_t filterShift;
+    bool eventEnable;
+    uint8_t eventDebounce;
+    uint8_t eventGapFrames;
+    bool intOnChange;
+    uint16_t intPositionDelta;
+    uint8_t protocolVersion;
+    uint16_t scanPeriod;
+    uint16_t scanMask;
+    uint8_t roiWidth;
+    uint8_t roiFullScanInterval;
 } config_struct;
 
 /**
@@ -115,12 +265,17 @@ inline bool isReadOperation(char reg){ return (reg & 0x01) ? false : true;}
  * intEnable:  controls if an interrupt request is sent to the master when 
  *             finishing the reading of the sensors (1 bit).
  * txDelay:    controls the time that the uc waits before sending an answer 
- *             to the master. (8 bits) TODO: document what the unit measures
+ *             to the master, in milliseconds or in bit times depending on
+ *             the protocol version (8 bits).
  * enable:     controls if the uc starts reading data and sending interrupt
  *             requests (if enabled) to the master (1 bit).
  * enableCRC:  controls if the uc will validate the in or out data with the CRC
  *             if it's incorrect it'll ignore the datagram (1 bit).
- * acumulator: (6 bits)TODO: document what it does.
+ * acumulator: log2 of the samples accumulated by the ADC for each sensor,
+ *             0 (1 sample) to 6 (64 samples), the result is shifted back to
+ *             10 bits so more samples mean less noise and a lower frame rate,
+ *             the change is applied at the start of the next scan (3 bits,
+ *             byte 2 bits 2-4).
  * baudrate:   controls the baudrate of the communication by default it's 115200
  *             the supported baudrates are listed in the baudrate_t enum
  *             (8 bits)
@@ -142,20 +297,23 @@ inline bool isReadOperation(char reg){ return (reg & 0x01) ? false : true;}
 bool registerConfig(char reg, volatile char* msg, char* response, IRSensor* sensors);
 
 /**
- * @brief Processes the datagram and generates a response based on the provided data.
+ * @brief This function gets the data for the status register
  *
- * This function processes the incoming datagram, performs some calculations, and generates a response based on the provided data. It also interacts with the IRSensor structure to gather additional information.
+ * Reports the binary value of every sensor, sensors that weren't converted in
+ * the last frame (scan mask or region of interest) are reported as 0.
+ * This register is read only.
+ * 
+ * binary:    bytes 0-1, one bit per sensor, sensor 0 in bit 0 (little endian).
+ * frameMask: bytes 2-3, sensors converted in the last frame (little endian).
  *
- * @param[in] datagram A pointer to the volatile character array containing the incoming datagram.
- * @param[out] response A pointer to the character array to store the generated response.
- * @param[in,out] sensors A pointer to the IRSensor structure containing data from infrared sensors.
+ * @param[reg] address of the requested operation.
+ * @param[msg] unused, can be set to NULL.
+ * @param[response] pointer to an array that it will contain the variables of the register.
+ * @param[IRSensor] array of sensors to read the binary values from.
  *
  * @return A boolean value indicating the success of processing the datagram.
  * @retval true The datagram was successfully processed and a response was generated.
- * @retval false An error occurred during processing.
- *
- * @warning The datagram and response buffers must be appropriately sized to avoid buffer overflows.
- * @note It is the caller's responsibility to manage memory for the response buffer.
+ * @retval false no response required since the register is read only.
  *
  * @see IRSensor
  */
@@ -191,6 +349,129 @@ bool registerStatus(char reg, volatile char* msg, char *response, IRSensor* sens
  */
 bool registerRawIRDataBlockX(char reg, volatile char* msg, char* response, block_t block, IRSensor* sensors);
 
+/**
+ * @struct block8_t
+ *
+ * @brief Represents a block of 4 infrared sensors for the 8 bit raw registers.
+ */
+typedef enum {
+    BLOCK8_0 = 0,  /**< block 0 contains the sensors [0-3]. */
+    BLOCK8_1 = 4,  /**< block 1 contains the sensors [4-7]. */
+    BLOCK8_2 = 8,  /**< block 2 contains the sensors [8-11]. */
+    BLOCK8_3 = 12, /**< block 3 contains the sensors [12-15]. */
+} block8_t;
+
+/**
+ * @brief This function gets the data for the 8 bit raw infrared data register
+ *
+ * Same as registerRawIRDataBlockX with the 8 most significant bits of each
+ * value, 4 sensors fit in the payload so the whole frame is read in 4
+ * transactions instead of 6, this is meant for the 8 bit resolution mode
+ * where the 2 lower bits are always 0 but it can be used in any mode.
+ * This register is read only.
+ * 
+ * rawValue0: byte 0
+ * rawValue1: byte 1
+ * rawValue2: byte 2
+ * rawValue3: byte 3
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] unused, can be set to NULL.
+ * @param[response] pointer to an array that it will contain the variables of the register.
+ * @param[block] index of the desired block of sensors.
+ * @param[IRSensor] array of sensors to read the values from.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false no response required since the register is read only.
+ *
+ * @see block8_t
+ */
+bool registerRaw8IRDataBlockX(char reg, volatile char* msg, char* response, block8_t block, IRSensor* sensors);
+
+/**
+ * @brief This function gets the 8 bit raw data of all the infrared sensors in
+ * one transaction.
+ *
+ * One byte per sensor with the 8 most significant bits of the value, sensor 0
+ * in byte 0, the payload is RAW8_DATA_ALL_SIZE bytes. Sensors that weren't
+ * converted in the last frame (scan mask or region of interest) report 0xFF,
+ * the mask of the frame is reported by the scan mask register.
+ * This register is read only.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] unused, can be set to NULL.
+ * @param[response] pointer to an array of at least RAW8_DATA_ALL_SIZE bytes.
+ * @param[IRSensor] array of sensors to read the values from.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false no response required since the register is read only.
+ *
+ * @see registerRaw8IRDataBlockX
+ */
+bool registerRaw8IRDataAll(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function gets the raw data of all the infrared sensors in one
+ * transaction.
+ *
+ * The 16 raw values are packed back to back (10 bits each, LSB first) in
+ * RAW_DATA_ALL_SIZE bytes, sensor 0 starts at bit 0 of the first byte, this
+ * is the same layout used by the raw block registers extended to the whole
+ * frame. Since all values are taken from the same sensors array they belong
+ * to the same frame. Sensors that weren't converted in the last frame (scan
+ * mask or region of interest) report IR_SENSOR_MASKED_VALUE, the mask of the
+ * frame is reported by the scan mask register.
+ * This register is read only.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] unused, can be set to NULL.
+ * @param[response] pointer to an array of at least RAW_DATA_ALL_SIZE bytes.
+ * @param[IRSensor] array of sensors to read the values from.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false no response required since the register is read only.
+ *
+ * @see registerRawIRDataBlockX
+ */
+bool registerRawIRDataAll(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function gets the normalized values of all the infrared sensors
+ * in one transaction.
+ *
+ * Every value is scaled between the lower (0) and upper (NORMALIZED_MAX)
+ * calibration of its sensor, the layout is the same as
+ * registerRawIRDataAll, 16 values of 10 bits packed back to back in
+ * RAW_DATA_ALL_SIZE bytes. Sensors that weren't converted in the last frame
+ * report IR_SENSOR_MASKED_VALUE.
+ * This register is read only.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] unused, can be set to NULL.
+ * @param[response] pointer to an array of at least RAW_DATA_ALL_SIZE bytes.
+ * @param[IRSensor] array of sensors to read the values from.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false no response required since the register is read only.
+ *
+ * @see normalizeValue
+ */
+bool registerNormalizedAll(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief stores a 10 bit value at position index of a back to back packed
+ * array (LSB first), the value is OR'ed so the array must start zeroed.
+ *
+ * @param[response] destination array.
+ * @param[index] position of the value, value 0 starts at bit 0 of byte 0.
+ * @param[value] value to store, only the lower 10 bits are used.
+ */
+void pack10BitValue(char* response, uint8_t index, uint16_t value);
+
 /**
  * @brief This function processes or gets the data for the upper calibration infrared register
  * 
@@ -251,6 +532,530 @@ bool registerUpperCalibblockX(char reg, volatile char* msg, char* response, bloc
  */
 bool registerLowerCalibblockX(char reg, volatile char* msg, char* response, block_t block, IRSensor* sensors);
 
+/**
+ * @brief This function processes or gets the data for the streaming register
+ *
+ * When streaming is enabled every completed scan is sent to the master without
+ * a request, the frame uses the layout of the bulk raw data register preceded
+ * by a sequence number and the mask of the sensors converted in the frame
+ * (little endian):
+ * 
+ * [LS_SYNC, LS_ADDR, LS_REGISTER_STREAM read, sequence, mask low, mask high,
+ *  20 bytes raw, CRC]
+ * 
+ * The scan must be enabled in the config register. A datagram to any other
+ * register stops the stream so the master can talk to the uc, to keep
+ * streaming after it the master needs to enable it again. Reading this
+ * register doesn't stop it, the frames are held back while a datagram or the
+ * reply of a read is pending.
+ * 
+ * streamEnable: byte 0 bit 0 (read/write).
+ * sequence:     byte 1, sequence number of the last frame sent (read only).
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[sequence] current sequence number reported in a read operation.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ */
+bool registerStream(char reg, volatile char* msg, char* response, uint8_t sequence);
+
+/**
+ * @brief This function gets the data for the line position register
+ *
+ * The line position is computed by the uc after every scan, with it the
+ * master doesn't need to read the raw values to follow the line.
+ * This register is read only.
+ * 
+ * position:    bytes 0-1, Q8.8 sensor index (little endian).
+ * linePresent: byte 2 bit 0.
+ * contrast:    byte 3.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] unused, can be set to NULL.
+ * @param[response] pointer to an array that it will contain the variables of the register.
+ * @param[line] line position computed in the last scan.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false no response required since the register is read only.
+ *
+ * @see linePosition_t
+ */
+bool registerLinePosition(char reg, volatile char* msg, char* response, linePosition_t* line);
+
+/**
+ * @brief returns the frames per second expected for the current configuration.
+ *
+ * The frame time is calculated from the ADC timing register, the accumulated
+ * samples per sensor and the delay between scans (sampleRate or the scan
+ * timer period).
+ *
+ * @return the frames per second.
+ */
+uint16_t getFrameRate();
+
+/**
+ * @brief This function gets the data for the frame rate register
+ *
+ * Reports the effective frames per second of the selected acquisition mode so
+ * the master can see the cost of the acumulator setting.
+ * This register is read only.
+ * 
+ * fps:        bytes 0-1 (little endian).
+ * acumulator: byte 2, log2 of the accumulated samples per sensor.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] unused, can be set to NULL.
+ * @param[response] pointer to an array that it will contain the variables of the register.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false no response required since the register is read only.
+ *
+ * @see getFrameRate
+ */
+bool registerFrameRate(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function processes or gets the data for the scan timer register
+ *
+ * Configures the hardware timed scans, when the period is not 0 the scans are
+ * started by TCB0 through the event system and the sampleRate of the config
+ * register is ignored. The period is stored with the settings register.
+ * 
+ * period: bytes 0-1, microseconds between scans, 0 disables the hardware
+ *         timing (read/write).
+ * jitter: bytes 2-3, variation of the scan completion time in TCB0 ticks
+ *         (SCAN_TIMER_TICKS_PER_US per microsecond) measured since the last
+ *         read (read only).
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ *
+ * @see scanTimerSetPeriod
+ */
+bool registerScanTimer(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function processes or gets the data for the scan config register
+ *
+ * Configures how the sensors are scanned.
+ * 
+ * settleTime: byte 0, ADC clock cycles the sensor gets to settle after it's
+ *             selected, 0 to SCAN_MAX_SETTLE_TIME. The sensor is latched
+ *             right before its conversion starts, so the settle time extends
+ *             the sampling time (SAMPLEN, added to adcSampleLength and
+ *             saturated to ADC_MAX_SAMPLE_LENGTH) and the sample is held
+ *             after the sensor settled. With accumulation every sample is
+ *             extended, the lower the value the higher the frame rate.
+ * windowCompare: byte 1 bit 0, the upper/lower thresholds of every sensor are
+ *             loaded in the ADC window comparator while scanning and the
+ *             binary values are built in the conversion path instead of
+ *             comparing every sensor after the scan, each sensor is compared
+ *             only against the threshold that changes its value and the
+ *             WCMP flag toggles it. The mode starts from the binary values
+ *             of the last scan. The filter is not applied in this mode.
+ * resolution8Bit: byte 1 bit 1, the ADC converts with 8 bits, the values are
+ *             shifted to the 10 bit scale so the calibration and the
+ *             registers keep working, read them with the 8 bit raw registers
+ *             to get 4 sensors per transaction. The change is applied at the
+ *             start of the next scan.
+ * filterShift: byte 2, strength of the low pass filter applied to the value
+ *             of every sensor after each scan, an exponential moving average
+ *             with alpha = 1 / (1 << filterShift), 0 disables the filter and
+ *             FILTER_MAX_SHIFT is the strongest. It runs in the main loop
+ *             so the scan rate is not affected. In window comparator mode
+ *             the binary values come from the raw conversions, so the filter
+ *             is bypassed and the values match them, it's seeded again when
+ *             the mode is disabled.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ */
+bool registerScanConfig(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function processes or gets the data for the scan mask register
+ *
+ * Selects the sensors that are scanned, the disabled sensors are skipped in the
+ * shift register selection and in the ADC so the frame rate scales with the
+ * amount of enabled sensors. The new mask is used from the next scan.
+ * 
+ * scanMask:  bytes 0-1, one bit per sensor, sensor 0 in bit 0 (little endian),
+ *            a mask of 0 is ignored.
+ * frameMask: bytes 2-3, sensors converted in the frame reported by the data
+ *            registers, the scan mask reduced to the region of interest. The
+ *            sensors that are not in it report IR_SENSOR_MASKED_VALUE (read
+ *            only).
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ *
+ * @see IR_SENSOR_MASKED_VALUE
+ */
+bool registerScanMask(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function processes or gets the data for the ADC timing register
+ *
+ * Configures the timing of the conversions so it can be tuned for each board
+ * without reflashing, a slower ADC clock and a longer sampling time give the
+ * sensor output more time to charge the sample capacitor at the cost of frame
+ * rate. The result can be checked with the ADC measurement register.
+ * 
+ * adcPrescaler:    byte 0, the ADC clock is CLK_PER / (2 << adcPrescaler),
+ *                  0 to ADC_MAX_PRESCALER.
+ * adcSampleLength: byte 1, ADC clock cycles added to the sampling time of
+ *                  every conversion, 0 to ADC_MAX_SAMPLE_LENGTH, the settle
+ *                  time of the scan config register is added to it.
+ * adcInitDelay:    byte 2, delay before the first conversion after the ADC is
+ *                  enabled, 0 (none) or 16 << (adcInitDelay - 1) ADC clock
+ *                  cycles, up to ADC_MAX_INIT_DELAY. The hardware only
+ *                  applies INITDLY when the ADC is enabled, so the ADC is
+ *                  enabled again between scans when the value changes and
+ *                  the delay is added to the first conversion after it.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ *
+ * @see registerADCMeasurement
+ */
+bool registerADCTiming(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function gets the data for the ADC measurement register
+ *
+ * Reports the scan timing measured with TCB0 on the last completed scan, the
+ * result includes the conversion, the settle time and the selection overhead
+ * so it reflects the real cost of the ADC timing, accumulation and scan
+ * configuration.
+ * This register is read only.
+ * 
+ * channelTime: bytes 0-1, time per sensor in TCB0 ticks
+ *              (SCAN_TIMER_TICKS_PER_US per microsecond).
+ * fps:         bytes 2-3, frames per second from the measured scan time and
+ *              the configured time between scans (scan timer period or
+ *              sampleRate).
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] unused, can be set to NULL.
+ * @param[response] pointer to an array that it will contain the variables of the register.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false no response required since the register is read only.
+ *
+ * @see scanTimerGetChannelTime
+ */
+bool registerADCMeasurement(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function processes or gets the data for the auto calibration register
+ *
+ * Writing the register starts a calibration sweep, the minimum and maximum of
+ * every sensor in the scan mask are tracked for the requested amount of scans
+ * and then the thresholds are placed around the middle of the measured range:
+ * upper = mid + range * upperMargin / 256, lower = mid - range * lowerMargin / 256.
+ * No datagrams are needed during the sweep, the completion is reported with
+ * the interrupt pin (even if intEnable is disabled) and the interrupts of
+ * every scan are suppressed while the sweep runs. The binary values are not
+ * valid during the sweep.
+ * 
+ * scans:       byte 0, scans of the sweep, 0 ends a running sweep with the
+ *              scans done so far (read: scans left).
+ * upperMargin: byte 1, up to CALIBRATION_MAX_MARGIN.
+ * lowerMargin: byte 2, up to CALIBRATION_MAX_MARGIN.
+ * running:     byte 3, 1 while the sweep is running (read only).
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] array of sensors to calibrate.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ *
+ * @see calibrationStart
+ */
+bool registerAutoCalibration(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function processes or gets the data for the settings register
+ *
+ * Stores or loads the configuration (config_struct) and the calibration of
+ * every sensor in EEPROM, the stored settings are loaded automatically at boot
+ * so the bar is ready without any datagram, including the baudrate. The
+ * stream is always disabled after loading, the scan timer period is restored
+ * with the rest of the configuration. Saving uses the blocking EEPROM writes,
+ * every changed byte takes ~3.3ms so a full save stalls the main loop for
+ * tens of milliseconds (up to ~300ms if every byte changed), no datagram is
+ * answered and no scan is processed meanwhile.
+ * 
+ * command: byte 0, SETTINGS_CMD_SAVE, SETTINGS_CMD_LOAD or SETTINGS_CMD_ERASE
+ *          (erase makes the next boot use the build defaults), read: last
+ *          command.
+ * result:  byte 1, 1 if the last command succeeded (read only).
+ * valid:   byte 2, 1 if the EEPROM holds valid settings (read only).
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] array of sensors whose thresholds are stored or loaded.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ *
+ * @see settingsSave
+ */
+bool registerSettings(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief loads the settings stored in EEPROM if they are valid, this is
+ * called by initializeStateMachine.
+ *
+ * @param[sensors] sensors whose thresholds are loaded.
+ *
+ * @return true if the settings were loaded.
+ */
+bool loadSettings(IRSensor* sensors);
+
+/**
+ * @brief applies the configuration that is not latched by the scans to the
+ * peripherals (baudrate, settle time and ADC timing), used after the whole
+ * config_struct is replaced.
+ */
+void applyConfig();
+
+/**
+ * @brief applies the scan timer period of the configuration, when the scans
+ * go back to software and they are enabled the next one is started since
+ * nothing else schedules it.
+ *
+ * @see scanTimerSetPeriod
+ */
+void applyScanPeriod();
+
+/**
+ * @brief This function processes or gets the data for the region of interest register
+ *
+ * In region of interest mode only a window of sensors centred on the line
+ * position of the previous scan is scanned, this raises the update rate of the
+ * sensors that follow the line. A full scan is done every roiFullScanInterval
+ * scans and whenever the line is lost so it can be found again. The sensors
+ * outside the window are reported as IR_SENSOR_MASKED_VALUE in the scans where
+ * they are skipped, the frame mask of the scan mask register tells which
+ * ones were scanned.
+ * 
+ * roiWidth:            byte 0, sensors in the window, 0 disables the mode.
+ * roiFullScanInterval: byte 1, a full scan is done every this many scans,
+ *                      values of 0 and 1 always do a full scan.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ *
+ * @see lineWindowMask
+ */
+bool registerROI(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function gets the data for the line velocity register
+ *
+ * Reports the motion of the line calculated with the timestamps of the scans,
+ * so the derivative doesn't include the jitter of the bus. The units are
+ * described in linePosition_t.
+ * This register is read only.
+ * 
+ * velocity:     bytes 0-1, signed, Q8.8 sensors per ms (little endian).
+ * acceleration: bytes 2-3, signed, Q8.8 sensors per ms^2 (little endian).
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] unused, can be set to NULL.
+ * @param[response] pointer to an array that it will contain the variables of the register.
+ * @param[line] line position with the motion to report.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false no response required since the register is read only.
+ *
+ * @see updateLineMotion
+ */
+bool registerLineVelocity(char reg, volatile char* msg, char* response, linePosition_t* line);
+
+/**
+ * @brief This function processes or gets the data for the protocol register
+ *
+ * Selects the protocol version, with PROTOCOL_VERSION_BIT_TIMES the reply
+ * delay (txDelay) is counted in bit times from the stop bit of the last byte
+ * of the request with a hardware one shot timer, so the reply starts as soon
+ * as the master released the line instead of waiting at least a millisecond.
+ * The master should only select it once it knows the firmware supports it,
+ * a firmware without this register doesn't answer the read.
+ * 
+ * protocolVersion: byte 0, PROTOCOL_VERSION_LEGACY or
+ *                  PROTOCOL_VERSION_BIT_TIMES, other values are ignored.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ */
+bool registerProtocol(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief returns the reply delay of the bit time protocol.
+ *
+ * @return txDelay bit times at the current baudrate in scheduler ticks.
+ *
+ * @see schedulerStartTicks
+ */
+uint32_t getTxDelayTicks();
+
+/**
+ * @brief This function processes or gets the data for the event latency
+ * register
+ *
+ * Reports the time that the events of the main loop waited from the ISR that
+ * posted them until they were handled, this is the wake up from the IDLE
+ * sleep plus the work of the main loop that was already running.
+ * 
+ * write:
+ * source: byte 0, EVENT_DATAGRAM, EVENT_REPLY or EVENT_SCAN, selects the
+ *         source reported by the reads, other values are ignored.
+ * clear:  byte 1, any value different from 0 clears the statistics of all
+ *         the sources.
+ * 
+ * read (microseconds, saturated to 0xFFFF):
+ * last:   bytes 0-1, latency of the last event of the selected source.
+ * max:    bytes 2-3, highest latency of the selected source since the last
+ *         clear.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ *
+ * @see eventGetLatency
+ */
+bool registerEventLatency(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function processes or gets the data for the line event register
+ *
+ * The features of the track (intersections, T junctions, branches, gaps and
+ * the end of the line) are detected on every scan from the binary values, see
+ * lineEvent_t for the codes. When eventEnable is set the interrupt pin is
+ * only raised when an event is detected instead of after every scan, so the
+ * master doesn't need to inspect every frame.
+ * 
+ * event:          byte 0, last event, it's cleared by the read (read only).
+ * count:          byte 1, events detected, wraps around (read only).
+ * eventDebounce:  byte 2 bits 0-6, scans a pattern must be seen before it's
+ *                 accepted, 1 to 127, dropouts shorter than this are ignored.
+ * eventEnable:    byte 2 bit 7, interrupt only on events.
+ * eventGapFrames: byte 3, the line missing for up to this many scans is a
+ *                 gap, longer is the end of the line.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ *
+ * @see lineEventUpdate
+ */
+bool registerLineEvent(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
+/**
+ * @brief This function processes or gets the data for the interrupt register
+ *
+ * Selects when the interrupt pin is raised while intEnable is set and reports
+ * why it was raised. In change mode the interrupt is only raised when the
+ * binary value of the sensors changes or when the line position moves more
+ * than intPositionDelta from the position of the last position interrupt,
+ * otherwise it's raised after every scan. Reading the register returns the
+ * causes accumulated since the last read, they are cleared and the pin is
+ * released once the reply is sent so the master is served in one transaction
+ * and a reply that is never sent doesn't lose them.
+ * 
+ * cause:            byte 0, INT_CAUSE_* bits (read only, cleared by the read).
+ * intOnChange:      byte 1 bit 0, interrupt on change mode.
+ * intPositionDelta: bytes 2-3, Q8.8 sensors (little endian), 0 disables the
+ *                   position trigger.
+ *
+ * @param[reg] address of the requested operation.
+ * @param[msg] pointer to an array containing the data used to configure the register.
+ * @param[response] pointer to an array that it will contain the variables of the register if a read operation
+ * was requested.
+ * @param[IRSensor] unused, can be set to NULL.
+ *
+ * @return A boolean value indicating the success of processing the datagram.
+ * @retval true The datagram was successfully processed and a response was generated.
+ * @retval false the datagram was processed and no response is required.
+ *
+ * @see readInterruptCause
+ */
+bool registerInterrupt(char reg, volatile char* msg, char* response, IRSensor* sensors);
+
 config_struct* getConfig();
 
 #ifdef	__cplusplus
@@ -0,0 +1,136 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <avr/interrupt.h>
+
+#include "scan_timer.h"
+#include "mcc_generated_files/adc/adc0.h"
+#include "mcc_generated_files/system/utils/atomic.h"
+
+uint16_t scanPeriod = 0;
+volatile uint16_t scanTimeMin = 0xFFFF;
+volatile uint16_t scanTimeMax = 0;
+volatile uint16_t lastScanTime = 0;
+volatile uint8_t lastScanChannels = 0;
+// ticks counted by the completed periods of TCB0 and the start of the current
+// scan when it's started by software
+volatile uint32_t timerBase = 0;
+volatile uint32_t lastScanTimestamp = 0;
+volatile uint32_t scanStart = 0;
+
+void scanTimerSetPeriod(uint16_t us){
+    if(us > SCAN_TIMER_MAX_PERIOD_US){
+        us = SCAN_TIMER_MAX_PERIOD_US;
+    }
+    scanPeriod = us;
+    
+    ENTER_CRITICAL(period);
+    // the ticks of the interrupted period are kept in the timestamp
+    timerBase += TCB0.CNT;
+    TCB0.CTRLA = 0;
+    // CNTMODE periodic interrupt, the CAPT event is generated on every period
+    TCB0.CTRLB = TCB_CNTMODE_INT_gc;
+    TCB0.CNT = 0;
+    TCB0.INTFLAGS = TCB_CAPT_bm;
+    TCB0.INTCTRL = TCB_CAPT_bm;
+    EXIT_CRITICAL(period);
+    if(us == 0){
+        ADC0_DisableAutoTrigger();
+        EVSYS.ASYNCUSER1 = EVSYS_ASYNCUSER1_OFF_gc;
+        // free running, only used to measure the scans
+        TCB0.CCMP = 0xFFFF;
+        TCB0.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+        return;
+    }
+    TCB0.CCMP = us * SCAN_TIMER_TICKS_PER_US - 1;
+    // TCB0 CAPT -> SYNCCH0 -> ADC0 start conversion
+    EVSYS.SYNCCH0 = EVSYS_SYNCCH0_TCB0_gc;
+    EVSYS.ASYNCUSER1 = EVSYS_ASYNCUSER1_SYNCCH0_gc;
+    ADC0_EnableAutoTrigger();
+    scanTimeMin = 0xFFFF;
+    scanTimeMax = 0;
+    TCB0.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+}
+
+uint16_t scanTimerGetPeriod(){
+    return scanPeriod;
+}
+
+void scanTimerOverflow(){
+    TCB0.INTFLAGS = TCB_CAPT_bm;
+    timerBase += (uint32_t)TCB0.CCMP + 1;
+}
+
+ISR(TCB0_INT_vect)
+{
+    // the interrupt flag is cleared by scanTimerOverflow
+    scanTimerOverflow();
+}
+
+uint32_t scanTimerGetTimestamp(){
+    ENTER_CRITICAL(timestamp);
+    uint32_t timestamp = lastScanTimestamp;
+    EXIT_CRITICAL(timestamp);
+    return timestamp;
+}
+
+/**
+ * @brief extends a value of the counter to the 32 bit time, interrupts must
+ * be disabled.
+ */
+static uint32_t timerExtend(uint16_t now){
+    uint32_t base = timerBase;
+    // a wrap that was not counted yet is still pending
+    if((TCB0.INTFLAGS & TCB_CAPT_bm) && now < (TCB0.CCMP >> 1)){
+        base += (uint32_t)TCB0.CCMP + 1;
+    }
+    return base + now;
+}
+
+void scanTimerScanStarted(){
+    ENTER_CRITICAL(started);
+    scanStart = timerExtend(TCB0.CNT);
+    EXIT_CRITICAL(started);
+}
+
+void scanTimerFrameComplete(uint8_t channels){
+    uint16_t now = TCB0.CNT;
+    lastScanTimestamp = timerExtend(now);
+    if(scanPeriod == 0){
+        // the stopwatch wraps every 0xFFFF ticks, slow scans are measured with
+        // the 32 bit time and saturated
+        uint32_t elapsed = lastScanTimestamp - scanStart;
+        lastScanTime = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+    }else{
+        lastScanTime = now;
+    }
+    lastScanChannels = channels;
+    if(scanPeriod == 0){
+        return;
+    }
+    scanTimeMin = now < scanTimeMin ? now : scanTimeMin;
+    scanTimeMax = now > scanTimeMax ? now : scanTimeMax;
+}
+
+uint16_t scanTimerGetScanTime(){
+    ENTER_CRITICAL(scanTime);
+    uint16_t ticks = lastScanTime;
+    EXIT_CRITICAL(scanTime);
+    return ticks;
+}
+
+uint16_t scanTimerGetChannelTime(){
+    ENTER_CRITICAL(channelTime);
+    uint16_t ticks = lastScanTime;
+    uint8_t channels = lastScanChannels;
+    EXIT_CRITICAL(channelTime);
+    return channels == 0 ? 0 : ticks / channels;
+}
+
+uint16_t scanTimerGetJitter(){
+    ENTER_CRITICAL(jitter);
+    uint16_t jitter = scanTimeMax > scanTimeMin ? scanTimeMax - scanTimeMin : 0;
+    scanTimeMin = 0xFFFF;
+    scanTimeMax = 0;
+    EXIT_CRITICAL(jitter);
+    return jitter;
+}
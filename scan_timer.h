@@ -0,0 +1,137 @@
+/*
+ * File:                scan_timer.h
+ * Author:              Hector Manuel
+ * Comments:
+ * Revision history:
+ */
+
+
+#ifndef SCAN_TIMER_H
+#define	SCAN_TIMER_H
+
+/**
+ * @file scan_timer.h
+ *
+ * @brief hardware timed start of the scans.
+ *
+ * TCB0 runs in periodic interrupt mode and its capture event is routed through
+ * the event system to the ADC start input, so the first conversion of every
+ * scan starts exactly at the timer period without any software involved, the
+ * rest of the scan is chained by ADCSampleReady.
+ *
+ * When the scans are started by software TCB0 keeps running as a stopwatch so
+ * the duration of every scan can be measured in both modes.
+ *
+ * The counter is extended to 32 bits with its capture interrupt so every
+ * completed scan gets a timestamp, the TCB0 INT ISR is defined in
+ * scan_timer.c. In periodic mode it fires (and wakes the CPU from sleep) once
+ * every scan period, as a stopwatch once every 0xFFFF ticks.
+ */
+
+#include <xc.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief TCB0 ticks per microsecond, TCB0 runs from CLK_PER / 2.
+ */
+#define SCAN_TIMER_TICKS_PER_US     (F_CPU / 2000000UL)
+
+/**
+ * @brief longest period supported by the 16 bit counter.
+ */
+#define SCAN_TIMER_MAX_PERIOD_US    (0xFFFF / SCAN_TIMER_TICKS_PER_US)
+
+/**
+ * @brief configures the period of the hardware timed scans.
+ *
+ * @param[us] period between the start of two scans in microseconds, 0 stops
+ * the timer and the scans are started by software again (sampleRate). Values
+ * above SCAN_TIMER_MAX_PERIOD_US are saturated. The period must be longer
+ * than the time needed to scan all the sensors.
+ *
+ * @note the software scans are only scheduled when a scan completes, after
+ * setting the period to 0 the caller must start the next scan (startScan).
+ */
+void scanTimerSetPeriod(uint16_t us);
+
+/**
+ * @brief returns the configured scan period.
+ *
+ * @return the period in microseconds, 0 if the scans are started by software.
+ */
+uint16_t scanTimerGetPeriod();
+
+/**
+ * @brief extends the timestamp when TCB0 reaches its top value, this is
+ * called from the TCB0 INT ISR.
+ */
+void scanTimerOverflow();
+
+/**
+ * @brief returns the time at which the last scan completed.
+ *
+ * @return timestamp in TCB0 ticks, it wraps around after 2^32 ticks (~7
+ * minutes at 20MHz).
+ *
+ * @see SCAN_TIMER_TICKS_PER_US
+ */
+uint32_t scanTimerGetTimestamp();
+
+/**
+ * @brief marks the start of a scan started by software, this is called by
+ * startScan before the first conversion.
+ */
+void scanTimerScanStarted();
+
+/**
+ * @brief records the time at which a scan completed, this is called by
+ * ADCSampleReady when the last sensor is stored.
+ *
+ * The counter is reset by the event that starts a hardware timed scan, so the
+ * value read is the scan time and its variation is the jitter of the scan,
+ * scans started by software are measured from scanTimerScanStarted.
+ *
+ * @param[channels] sensors converted in the scan.
+ */
+void scanTimerFrameComplete(uint8_t channels);
+
+/**
+ * @brief returns the duration of the last completed scan.
+ *
+ * @return the scan time in TCB0 ticks, scans longer than 0xFFFF ticks
+ * (~6.5ms at 20MHz) are saturated to 0xFFFF.
+ *
+ * @see SCAN_TIMER_TICKS_PER_US
+ */
+uint16_t scanTimerGetScanTime();
+
+/**
+ * @brief returns the time taken by each sensor in the last completed scan,
+ * this includes the conversion, the settle time and the selection overhead.
+ *
+ * @return the time per channel in TCB0 ticks.
+ *
+ * @see SCAN_TIMER_TICKS_PER_US
+ */
+uint16_t scanTimerGetChannelTime();
+
+/**
+ * @brief returns the jitter measured since the last call.
+ *
+ * @return max - min scan completion time in TCB0 ticks, the measurement is
+ * restarted after the call.
+ *
+ * @see SCAN_TIMER_TICKS_PER_US
+ */
+uint16_t scanTimerGetJitter();
+
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* SCAN_TIMER_H */
+
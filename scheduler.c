@@ -0,0 +1,169 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <avr/interrupt.h>
+
+#include "scheduler.h"
+#include "mcc_generated_files/system/utils/atomic.h"
+
+// pending timers ordered by deadline and the upper 16 bits of the time
+schedulerTimer_t* volatile timerList = NULL;
+volatile uint16_t timeHigh = 0;
+
+void schedulerInit(){
+    TCA0.SINGLE.CTRLA = 0;
+    TCA0.SINGLE.CTRLB = TCA_SINGLE_WGMODE_NORMAL_gc;
+    TCA0.SINGLE.PER = 0xFFFF;
+    TCA0.SINGLE.CNT = 0;
+    TCA0.SINGLE.INTCTRL = 0;
+    TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm | TCA_SINGLE_CMP0_bm;
+    TCA0.SINGLE.CTRLA = TCA_SINGLE_CLKSEL_DIV16_gc | TCA_SINGLE_ENABLE_bm;
+}
+
+uint32_t schedulerNow(){
+    ENTER_CRITICAL(now);
+    uint16_t low = TCA0.SINGLE.CNT;
+    uint16_t high = timeHigh;
+    // an overflow that was not handled yet is still pending
+    if((TCA0.SINGLE.INTFLAGS & TCA_SINGLE_OVF_bm) && low < 0x8000){
+        high++;
+    }
+    EXIT_CRITICAL(now);
+    return (uint32_t)high << 16 | low;
+}
+
+/**
+ * @brief sets the flag and calls the function of an expired timer.
+ */
+static void schedulerExpire(schedulerTimer_t* timer){
+    if(timer->flag != NULL){
+        *timer->flag = true;
+    }
+    if(timer->funPtr != NULL){
+        timer->funPtr();
+    }
+}
+
+/**
+ * @brief expires the timers that already passed and loads the compare channel
+ * with the next deadline if it's in the current period of TCA0, the later
+ * ones are loaded by the overflow ISR. Interrupts must be disabled.
+ */
+static void schedulerArm(){
+    while(true){
+        TCA0.SINGLE.INTCTRL &= ~TCA_SINGLE_CMP0_bm;
+        if(timerList == NULL){
+            TCA0.SINGLE.INTCTRL &= ~TCA_SINGLE_OVF_bm;
+            return;
+        }
+        schedulerTimer_t* timer = timerList;
+        if((int32_t)(timer->deadline - schedulerNow()) <= 0){
+            timerList = timer->next;
+            timer->pending = false;
+            schedulerExpire(timer);
+            continue;
+        }
+        if((uint16_t)(timer->deadline >> 16) != timeHigh){
+            return;
+        }
+        TCA0.SINGLE.CMP0 = (uint16_t)timer->deadline;
+        TCA0.SINGLE.INTFLAGS = TCA_SINGLE_CMP0_bm;
+        TCA0.SINGLE.INTCTRL |= TCA_SINGLE_CMP0_bm;
+        // the counter may have passed the deadline while it was loaded
+        if((int32_t)(timer->deadline - schedulerNow()) > 0){
+            return;
+        }
+    }
+}
+
+/**
+ * @brief removes a timer from the list. Interrupts must be disabled.
+ */
+static void schedulerRemove(schedulerTimer_t* timer){
+    schedulerTimer_t* volatile* link = &timerList;
+    while(*link != NULL && *link != timer){
+        link = &(*link)->next;
+    }
+    if(*link == timer){
+        *link = timer->next;
+    }
+    timer->pending = false;
+}
+
+void schedulerStart(schedulerTimer_t* timer, uint32_t us, volatile bool* flag, void (*funPtr)()){
+    if(us > SCHEDULER_MAX_DELAY_US){
+        us = SCHEDULER_MAX_DELAY_US;
+    }
+    schedulerStartTicks(timer, (us * SCHEDULER_TICKS_PER_MS + 999) / 1000, flag, funPtr);
+}
+
+void schedulerStartTicks(schedulerTimer_t* timer, uint32_t ticks, volatile bool* flag, void (*funPtr)()){
+    if(ticks > 0x7FFFFFFFUL){
+        ticks = 0x7FFFFFFFUL;
+    }
+    ENTER_CRITICAL(start);
+    if(timer->pending){
+        schedulerRemove(timer);
+    }
+    timer->flag = flag;
+    timer->funPtr = funPtr;
+    if(ticks == 0){
+        EXIT_CRITICAL(start);
+        schedulerExpire(timer);
+        return;
+    }
+    if(timerList == NULL){
+        // TCA0 was not extended while idle, start a new epoch
+        timeHigh = 0;
+        TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm;
+        TCA0.SINGLE.INTCTRL |= TCA_SINGLE_OVF_bm;
+    }
+    timer->deadline = schedulerNow() + ticks;
+    schedulerTimer_t* volatile* link = &timerList;
+    while(*link != NULL && (int32_t)((*link)->deadline - timer->deadline) <= 0){
+        link = &(*link)->next;
+    }
+    timer->next = *link;
+    *link = timer;
+    timer->pending = true;
+    if(timerList == timer){
+        schedulerArm();
+    }
+    EXIT_CRITICAL(start);
+}
+
+void schedulerCancel(schedulerTimer_t* timer){
+    ENTER_CRITICAL(cancel);
+    if(timer->pending){
+        bool first = timerList == timer;
+        schedulerRemove(timer);
+        if(first){
+            schedulerArm();
+        }
+    }
+    EXIT_CRITICAL(cancel);
+}
+
+bool schedulerPending(schedulerTimer_t* timer){
+    return timer->pending;
+}
+
+void schedulerCompareISR(){
+    TCA0.SINGLE.INTFLAGS = TCA_SINGLE_CMP0_bm;
+    schedulerArm();
+}
+
+void schedulerOverflowISR(){
+    TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm;
+    timeHigh++;
+    schedulerArm();
+}
+
+ISR(TCA0_CMP0_vect)
+{
+    schedulerCompareISR();
+}
+
+ISR(TCA0_OVF_vect)
+{
+    schedulerOverflowISR();
+}
@@ -0,0 +1,139 @@
+/*
+ * File:                scheduler.h
+ * Author:              Hector Manuel
+ * Comments:
+ * Revision history:
+ */
+
+
+#ifndef SCHEDULER_H
+#define	SCHEDULER_H
+
+/**
+ * @file scheduler.h
+ *
+ * @brief tickless one shot timers with microsecond resolution.
+ *
+ * TCA0 counts CLK_PER / 16 and the pending timers are kept in a list ordered
+ * by deadline, the compare channel 0 is loaded with the deadline of the first
+ * one so the CPU is only interrupted when it expires. The overflow interrupt
+ * extends the counter to 32 bits and it's only enabled while there are
+ * pending timers, with no timers TCA0 doesn't interrupt at all.
+ *
+ * The expired timers are handled in the TCA0 CMP0 and OVF ISRs, they are
+ * defined in scheduler.c.
+ */
+
+#include <xc.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief TCA0 ticks per millisecond, the scheduler runs from CLK_PER / 16.
+ */
+#define SCHEDULER_TICKS_PER_MS      (F_CPU / 16000UL)
+
+/**
+ * @brief longest delay accepted by schedulerStart, longer ones are saturated.
+ */
+#define SCHEDULER_MAX_DELAY_US      (0x7FFFFFFFUL / SCHEDULER_TICKS_PER_MS)
+
+/**
+ * @struct schedulerTimer_t
+ *
+ * @brief a one shot timer, the memory is owned by the caller and it must stay
+ * valid while the timer is pending.
+ *
+ * deadline: TCA0 tick at which the timer expires.
+ * flag:     set to true when the timer expires, it can be NULL.
+ * funPtr:   called when the timer expires in the ISR context, it can be NULL.
+ * next:     next pending timer, used by the scheduler.
+ * pending:  true while the timer is in the list.
+ */
+typedef struct schedulerTimer_s{
+    uint32_t deadline;
+    volatile bool* flag;
+    void (*funPtr)();
+    struct schedulerTimer_s* volatile next;
+    volatile bool pending;
+} schedulerTimer_t;
+
+/**
+ * @brief configures TCA0 for the scheduler, it must be called before any
+ * timer is started.
+ */
+void schedulerInit();
+
+/**
+ * @brief starts or restarts a timer.
+ *
+ * If the timer is already pending it's moved to the new deadline. A delay of
+ * 0 expires right away in the caller's context.
+ *
+ * @param[timer] timer to start.
+ * @param[us] delay in microseconds, up to SCHEDULER_MAX_DELAY_US.
+ * @param[flag] flag set to true when the timer expires, it can be NULL.
+ * @param[funPtr] function called when the timer expires, it can be NULL, it
+ * runs in the ISR context so it must be short.
+ */
+void schedulerStart(schedulerTimer_t* timer, uint32_t us, volatile bool* flag, void (*funPtr)());
+
+/**
+ * @brief starts or restarts a timer with a delay in TCA0 ticks, used when the
+ * delay is derived from another clock (e.g. the USART bit time) to avoid
+ * rounding it to microseconds.
+ *
+ * @param[timer] timer to start.
+ * @param[ticks] delay in TCA0 ticks (SCHEDULER_TICKS_PER_MS per ms), up to
+ * 0x7FFFFFFF.
+ * @param[flag] flag set to true when the timer expires, it can be NULL.
+ * @param[funPtr] function called when the timer expires, it can be NULL.
+ *
+ * @see schedulerStart
+ */
+void schedulerStartTicks(schedulerTimer_t* timer, uint32_t ticks, volatile bool* flag, void (*funPtr)());
+
+/**
+ * @brief stops a pending timer, nothing is done if it's not pending.
+ *
+ * @param[timer] timer to stop.
+ */
+void schedulerCancel(schedulerTimer_t* timer);
+
+/**
+ * @brief reports if a timer is waiting to expire.
+ *
+ * @param[timer] timer to check.
+ *
+ * @return true if the timer is pending.
+ */
+bool schedulerPending(schedulerTimer_t* timer);
+
+/**
+ * @brief returns the current time of the scheduler.
+ *
+ * @return TCA0 ticks, only valid while there are pending timers since the
+ * counter is not extended without them.
+ */
+uint32_t schedulerNow();
+
+/**
+ * @brief handles the expired timers, this is called from the TCA0 CMP0 ISR.
+ */
+void schedulerCompareISR();
+
+/**
+ * @brief extends the counter to 32 bits, this is called from the TCA0 OVF
+ * ISR.
+ */
+void schedulerOverflowISR();
+
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* SCHEDULER_H */
+
@@ -0,0 +1,64 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <avr/eeprom.h>
+
+#include "config.h"
+#include "crc8.h"
+#include "settings_storage.h"
+
+typedef struct {
+    uint8_t version;
+    config_struct cfg;
+    uint16_t upper[IR_SENSOR_COUNT];
+    uint16_t lower[IR_SENSOR_COUNT];
+    uint8_t crc;
+} storedSettings_t;
+
+_Static_assert(sizeof(storedSettings_t) <= EEPROM_SIZE, "the settings don't fit in the EEPROM");
+
+storedSettings_t EEMEM storedSettings;
+
+/**
+ * @brief calculates the CRC of the stored data reading it back from EEPROM.
+ */
+static uint8_t storedCRC(){
+    uint8_t crc = CRC8_INIT;
+    for(uint8_t* addr = (uint8_t*)&storedSettings; addr < &storedSettings.crc; addr++){
+        crc = crc8Update(crc, eeprom_read_byte(addr));
+    }
+    return crc8Final(crc);
+}
+
+bool settingsValid(){
+    return eeprom_read_byte(&storedSettings.version) == SETTINGS_STORAGE_VERSION &&
+           eeprom_read_byte(&storedSettings.crc) == storedCRC();
+}
+
+bool settingsSave(config_struct* cfg, IRSensor* sensors){
+    // the data is written in place to avoid a copy of the layout in RAM, the
+    // CRC is calculated from what was written so it also verifies the write
+    eeprom_update_byte(&storedSettings.version, SETTINGS_STORAGE_VERSION);
+    eeprom_update_block(cfg, &storedSettings.cfg, sizeof(config_struct));
+    for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
+        eeprom_update_word(&storedSettings.upper[i], sensors[i].upper);
+        eeprom_update_word(&storedSettings.lower[i], sensors[i].lower);
+    }
+    eeprom_update_byte(&storedSettings.crc, storedCRC());
+    return settingsValid();
+}
+
+bool settingsLoad(config_struct* cfg, IRSensor* sensors){
+    if(!settingsValid()){
+        return false;
+    }
+    eeprom_read_block(cfg, &storedSettings.cfg, sizeof(config_struct));
+    for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
+        sensors[i].upper = eeprom_read_word(&storedSettings.upper[i]);
+        sensors[i].lower = eeprom_read_word(&storedSettings.lower[i]);
+    }
+    return true;
+}
+
+void settingsErase(){
+    eeprom_update_byte(&storedSettings.version, 0xFF);
+}
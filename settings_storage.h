@@ -0,0 +1,78 @@
+/*
+ * File:                settings_storage.h
+ * Author:              Hector Manuel
+ * Comments:
+ * Revision history:
+ */
+
+
+#ifndef SETTINGS_STORAGE_H
+#define	SETTINGS_STORAGE_H
+
+/**
+ * @file settings_storage.h
+ *
+ * @brief keeps the configuration and the calibration in EEPROM.
+ *
+ * The config_struct and the thresholds of every sensor are stored with a
+ * CRC-8 so a blank or half written EEPROM is detected and the build defaults
+ * are used instead. The layout is versioned with SETTINGS_STORAGE_VERSION,
+ * changing the stored structures must increment it.
+ */
+
+#include <xc.h>
+#include "protocol_registers.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief version of the stored layout, stored data of another version is
+ * ignored.
+ */
+#define SETTINGS_STORAGE_VERSION    6
+
+/**
+ * @brief stores the configuration and the thresholds of the sensors.
+ *
+ * Only the bytes that changed are written, each written byte takes a few
+ * milliseconds and the call blocks until the last one is done.
+ *
+ * @param[cfg] configuration to store.
+ * @param[sensors] sensors whose thresholds are stored.
+ *
+ * @return true if the stored data was read back with a valid CRC.
+ */
+bool settingsSave(config_struct* cfg, IRSensor* sensors);
+
+/**
+ * @brief loads the configuration and the thresholds of the sensors, nothing
+ * is modified if the stored data is not valid.
+ *
+ * @param[cfg] destination of the configuration.
+ * @param[sensors] sensors whose thresholds are loaded.
+ *
+ * @return true if valid data was found and loaded.
+ */
+bool settingsLoad(config_struct* cfg, IRSensor* sensors);
+
+/**
+ * @brief invalidates the stored data so the next boot uses the build defaults.
+ */
+void settingsErase();
+
+/**
+ * @brief reports if the EEPROM holds valid data.
+ *
+ * @return true if the version and the CRC of the stored data match.
+ */
+bool settingsValid();
+
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* SETTINGS_STORAGE_H */
+
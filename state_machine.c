@@ -1,37 +1,43 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <avr/interrupt.h>
 
 #include "config.h"
 #include "state_machine.h"
 #include "protocol_registers.h"
 #include "hal_functions.h"
+#include "crc8.h"
+#include "line_position.h"
+#include "mcc_generated_files/adc/adc0.h"
+#include "scan_timer.h"
+#include "calibration.h"
+#include "normalization.h"
+#include "line_events.h"
+#include "scheduler.h"
+#include "event_loop.h"
+#include "mcc_generated_files/system/utils/atomic.h"
 
 volatile datagramStates datagramState = STATE_SYNC;
 volatile bool received_datagram = false;
+// running CRC of the datagram being received, updated with every byte so the
+// check in STATE_CRC is a single compare
+volatile uint8_t datagramCRC = CRC8_INIT;
+// sequence number of the last frame sent in streaming mode
+uint8_t streamSequence = 0;
+// one shot timers of the reply delay and of the delay between scans
+schedulerTimer_t txDelayTimer;
+schedulerTimer_t sampleRateTimer;
+// reply is set when the reply delay elapsed and replyPending when there is a
+// response waiting for it
+volatile bool reply = false;
+bool replyPending = false;
 
-
-
-bool datagramCalcCRC(volatile char* datagram, uint8_t datagramLength) {
-int i,j;
-char received_crc = datagram[datagramLength - 1];
-volatile char* crc = datagram + (datagramLength-1); // CRC located in last byte of message UCHAR currentByte;
-*crc = 0;
-char currentByte;
-for (i=0; i<(datagramLength-1); i++) {
-    currentByte = datagram[i];
-    for (j=0; j<8; j++) {
-      if ((*crc >> 7) ^ (currentByte&0x01))
-      {
-        *crc = (*crc << 1) ^ 0x07;
-      }
-else
-      {
-        *crc = (*crc << 1);
-}
-      currentByte = currentByte >> 1;
-    } // for CRC bit
-  } // for message byte
-return received_crc == *crc;
+/**
+ * @brief called by txDelayTimer when the reply delay elapses.
+ */
+static void replyDelayExpired(){
+    reply = true;
+    eventPost(EVENT_REPLY);
 }
 
 
@@ -39,7 +45,10 @@ return received_crc == *crc;
 bool datagramStateMachineProcessByte(volatile uint8_t byte, volatile char* rxBuff){
     bool validCRC = false;
     static bool isReadDatagram = false;
-    uint8_t datagramSize;
+    
+    if(datagramState != STATE_CRC){
+        datagramCRC = crc8Update(datagramState == STATE_SYNC ? CRC8_INIT : datagramCRC, byte);
+    }
     
     switch(datagramState){
         case STATE_SYNC:
@@ -65,12 +74,17 @@ bool datagramStateMachineProcessByte(volatile uint8_t byte, volatile char* rxBuf
             datagramState = STATE_CRC;
             return true;
         case STATE_CRC:
-            datagramSize = isReadDatagram ? DATAGRAM_READ_SIZE : DATAGRAM_WRITE_SIZE;
+            validCRC = crc8Final(datagramCRC) == byte;
             config_struct* config = getConfig();
             
-            validCRC = datagramCalcCRC(rxBuff,datagramSize);
             if (validCRC || config->enableCRC == false){
                 received_datagram = true;
+                eventPost(EVENT_DATAGRAM);
+                if(config->protocolVersion == PROTOCOL_VERSION_BIT_TIMES){
+                    // the delay is counted from the end of the request
+                    reply = false;
+                    schedulerStartTicks(&txDelayTimer, getTxDelayTicks(), NULL, replyDelayExpired);
+                }
                 //TODO remove this from function
                 USART0_SetReceiveCompleteISR(false);
                 //USART0.CTRLA &= ~(USART_RXCIE_bm);
@@ -84,12 +98,13 @@ bool datagramStateMachineProcessByte(volatile uint8_t byte, volatile char* rxBuf
 }
 
 
-bool processDatagram(volatile char* datagram, char* response, IRSensor* sensors){
+bool processDatagram(volatile char* datagram, char* response, uint8_t* responseSize, IRSensor* sensors){
     if(datagram[0] != LS_SYNC && datagram[1] != LS_ADDR){
         return false;
     }
     
     char reg = datagram[2];
+    *responseSize = DATAGRAM_RESPONSE_SIZE;
     response[0] = LS_SYNC;
     response[1] = LS_ADDR;
     response[2] = reg;
@@ -156,34 +171,162 @@ bool processDatagram(volatile char* datagram, char* response, IRSensor* sensors)
         case LS_REGISTER_LOWER_CALIBRATION_5:
             result = registerLowerCalibblockX(reg, &datagram[3], &response[3], BLOCK_5, sensors);
             break;
+        case LS_REGISTER_STREAM:
+            result = registerStream(reg, &datagram[3], &response[3], streamSequence);
+            break;
+        case LS_REGISTER_LINE_POSITION:
+            result = registerLinePosition(reg, NULL, &response[3], getLinePosition());
+            break;
+        case LS_REGISTER_FRAME_RATE:
+            result = registerFrameRate(reg, NULL, &response[3], NULL);
+            break;
+        case LS_REGISTER_SCAN_TIMER:
+            result = registerScanTimer(reg, &datagram[3], &response[3], NULL);
+            break;
+        case LS_REGISTER_SCAN_CONFIG:
+            result = registerScanConfig(reg, &datagram[3], &response[3], NULL);
+            break;
+        case LS_REGISTER_SCAN_MASK:
+            result = registerScanMask(reg, &datagram[3], &response[3], NULL);
+            break;
+        case LS_REGISTER_ROI:
+            result = registerROI(reg, &datagram[3], &response[3], NULL);
+            break;
+        case LS_REGISTER_RAW_DATA_ALL:
+            result = registerRawIRDataAll(reg, NULL, &response[3], sensors);
+            *responseSize = DATAGRAM_BULK_RESPONSE_SIZE;
+            break;
+        case LS_REGISTER_RAW8_DATA_0:
+            result = registerRaw8IRDataBlockX(reg, NULL, &response[3], BLOCK8_0, sensors);
+            break;
+        case LS_REGISTER_RAW8_DATA_1:
+            result = registerRaw8IRDataBlockX(reg, NULL, &response[3], BLOCK8_1, sensors);
+            break;
+        case LS_REGISTER_RAW8_DATA_2:
+            result = registerRaw8IRDataBlockX(reg, NULL, &response[3], BLOCK8_2, sensors);
+            break;
+        case LS_REGISTER_RAW8_DATA_3:
+            result = registerRaw8IRDataBlockX(reg, NULL, &response[3], BLOCK8_3, sensors);
+            break;
+        case LS_REGISTER_ADC_TIMING:
+            result = registerADCTiming(reg, &datagram[3], &response[3], NULL);
+            break;
+        case LS_REGISTER_ADC_MEASUREMENT:
+            result = registerADCMeasurement(reg, NULL, &response[3], NULL);
+            break;
+        case LS_REGISTER_AUTO_CALIBRATION:
+            result = registerAutoCalibration(reg, &datagram[3], &response[3], sensors);
+            break;
+        case LS_REGISTER_SETTINGS:
+            result = registerSettings(reg, &datagram[3], &response[3], sensors);
+            break;
+        case LS_REGISTER_NORMALIZED_ALL:
+            result = registerNormalizedAll(reg, NULL, &response[3], sensors);
+            *responseSize = DATAGRAM_BULK_RESPONSE_SIZE;
+            break;
+        case LS_REGISTER_LINE_EVENT:
+            result = registerLineEvent(reg, &datagram[3], &response[3], NULL);
+            break;
+        case LS_REGISTER_LINE_VELOCITY:
+            result = registerLineVelocity(reg, NULL, &response[3], getLinePosition());
+            break;
+        case LS_REGISTER_INTERRUPT:
+            result = registerInterrupt(reg, &datagram[3], &response[3], NULL);
+            break;
+        case LS_REGISTER_PROTOCOL:
+            result = registerProtocol(reg, &datagram[3], &response[3], NULL);
+            break;
+        case LS_REGISTER_EVENT_LATENCY:
+            result = registerEventLatency(reg, &datagram[3], &response[3], NULL);
+            break;
+        case LS_REGISTER_RAW8_DATA_ALL:
+            result = registerRaw8IRDataAll(reg, NULL, &response[3], sensors);
+            *responseSize = DATAGRAM_BULK8_RESPONSE_SIZE;
+            break;
         default :
             result = false;
     }
     if(result){
-        datagramCalcCRC(response,8);
+        response[*responseSize - 1] = crc8Block(response, *responseSize - 1);
     }
     return result;
 }
 
 
-char tx[BUFFER_SIZE];
+char tx[DATAGRAM_MAX_RESPONSE_SIZE];
+uint8_t txSize = DATAGRAM_RESPONSE_SIZE;
 volatile char rx[BUFFER_SIZE];
-volatile delayRequest delayRequests[MAX_DELAY_REQUESTS];
 
 volatile uint8_t activeSensor = 0;
 volatile bool sensorsSampleCmplt = false;
-volatile bool reply = false;
+// set while a scan is being converted, startScan doesn't start another one
+volatile bool scanRunning = false;
 
+// ping-pong frames, the ADC writes in rawADCFrames[adcFrame] while the last
+// completed scan stays untouched in rawADCFrames[readyFrame] until the next
+// scan completes and the indexes are swapped
+volatile uint16_t rawADCFrames[2][IR_SENSOR_COUNT];
+volatile uint8_t adcFrame = 0;
+volatile uint8_t readyFrame = 1;
+// incremented every time a frame is published, a change while the main loop
+// copies the ready frame means the ADC may be writing in it again
+volatile uint8_t frameSequence = 0;
+// log2 of the samples accumulated by the ADC in the current scan, the results
+// are shifted by it to get back to 10 bits
+volatile uint8_t accumulationShift = 0;
+// the current scan converts with 8 bits, the results are shifted up to the 10
+// bit scale
+volatile bool resolution8Bit = false;
+// INITDLY of the ADC, the hardware only applies it when the ADC is enabled
+uint8_t initDelay = 0;
+// sensors walked by the current scan, by the last completed one and by the
+// next one (scan mask plus the region of interest)
+volatile uint16_t scanMask = 0xFFFF;
+volatile uint16_t readyMask = 0xFFFF;
+// mask of the frame stored in sensors, updated by the main loop
+uint16_t frameMask = 0xFFFF;
+// sensors converted so far in the current scan
+volatile uint8_t scanChannels = 0;
+volatile uint16_t nextScanMask = 0xFFFF;
+// scans done with the region of interest since the last full scan
+uint8_t roiScans = 0;
+// in window comparator mode the binary value of the sensors is updated by the
+// conversion path, binaryState keeps the hysteresis between scans and
+// readyBinary holds the values of the last completed scan
+volatile bool windowCompare = false;
+volatile bool readyWindowCompare = false;
+volatile uint16_t binaryState = 0;
+volatile uint16_t readyBinary = 0;
 //TODO: 2 more allocations are done to avoid validating if the requested register
 // is block 5, due to it only having 1 channel
-volatile uint16_t rawADCValues[IR_SENSOR_COUNT+2];
 IRSensor sensors[IR_SENSOR_COUNT+2];
+// low pass filter state of every sensor, the 10 bit value in Q10.6, a sensor
+// that was skipped by a scan is seeded again with its next value
+uint16_t filterState[IR_SENSOR_COUNT];
+uint16_t filterSeeded = 0;
+// causes of the interrupts not read yet, bitmap of the last scan and line
+// position of the last position interrupt for the interrupt on change mode
+uint8_t interruptCause = 0;
+// causes returned by the last read of the interrupt register, they are only
+// cleared once the reply carrying them is sent
+uint8_t interruptAck = 0;
+uint16_t lastBitmap = 0;
+uint16_t lastIntPosition = 0;
 volatile StateMachineStatus sendingStatus;
 
 volatile uint8_t* getActiveSensor(){
     return &activeSensor;
 }
 
+uint16_t getFrameMask(){
+    return frameMask;
+}
+
+uint8_t readInterruptCause(){
+    interruptAck = interruptCause;
+    return interruptAck;
+}
+
 volatile bool* getSensorsSampleFlag(){
     return &sensorsSampleCmplt;
 }
@@ -197,38 +340,222 @@ volatile char* getRxBuffer(){
 }
 
 volatile uint16_t* getRawADCValues(){
-    return rawADCValues;
+    return rawADCFrames[readyFrame];
+}
+
+/**
+ * @brief returns the first sensor enabled in the mask starting at pos.
+ * 
+ * @param[mask] scan mask, one bit per sensor.
+ * @param[pos] first sensor to check.
+ * 
+ * @return the position of the sensor or IR_SENSOR_COUNT if there are no more
+ * enabled sensors.
+ */
+static uint8_t nextScanSensor(uint16_t mask, uint8_t pos){
+    while(pos < IR_SENSOR_COUNT && !((mask >> pos) & 1)){
+        pos++;
+    }
+    return pos;
+}
+
+/**
+ * @brief loads the threshold that changes the binary value of a sensor in the
+ * ADC window comparator, a sensor at 0 is compared against upper (above mode)
+ * and a sensor at 1 against lower (below mode), so the WCMP flag alone means
+ * the binary value toggles. The limits are scaled to the accumulated result.
+ * 
+ * @param[pos] sensor that is going to be converted.
+ */
+static void loadWindow(uint8_t pos){
+    uint8_t resolutionShift = resolution8Bit ? 2 : 0;
+    if((binaryState >> pos) & 1){
+        // result < WINLT is value <= lower
+        uint32_t low = (((uint32_t)sensors[pos].lower + 1) << accumulationShift) >> resolutionShift;
+        ADC0_SetWindowLow(low > 0xFFFF ? 0xFFFF : low);
+        ADC0_SetWindowMode(ADC0_window_below);
+    }else{
+        // result > WINHT is value >= upper
+        uint32_t high = sensors[pos].upper == 0 ? 0 : (((uint32_t)sensors[pos].upper - 1) << accumulationShift) >> resolutionShift;
+        ADC0_SetWindowHigh(high > 0xFFFF ? 0xFFFF : high);
+        ADC0_SetWindowMode(ADC0_window_above);
+    }
+}
+
+/**
+ * @brief selects the first sensor of the scan mask and prepares the second
+ * one so the scan can be started by software or by the scan timer.
+ */
+static void startScanSelection(){
+    activeSensor = nextScanSensor(scanMask, 0);
+    prepareBits(activeSensor);
+    // the window is loaded while the pattern is shifted
+    if(windowCompare){
+        loadWindow(activeSensor);
+    }
+    latchBits();
+    uint8_t next = nextScanSensor(scanMask, activeSensor + 1);
+    if(next < IR_SENSOR_COUNT){
+        prepareBits(next);
+    }
+}
+
+/**
+ * @brief latches the mask of the next scan and selects its first sensor.
+ */
+static void prepareNextScan(){
+    // a scan without sensors would select IR_SENSOR_COUNT, out of the frame
+    scanMask = nextScanMask != 0 ? nextScanMask : 0xFFFF;
+    bool enabled = getConfig()->windowCompare;
+    if(enabled && !windowCompare){
+        // the hysteresis continues from the binary values of the last scan
+        binaryState = 0;
+        for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
+            binaryState |= (uint16_t)sensors[i].procValue << i;
+        }
+    }
+    windowCompare = enabled;
+    if(!windowCompare){
+        ADC0_SetWindowMode(ADC0_window_disabled);
+    }
+    startScanSelection();
+}
+
+void startScan(){
+    ENTER_CRITICAL(start);
+    if(scanRunning){
+        EXIT_CRITICAL(start);
+        return;
+    }
+    scanRunning = true;
+    EXIT_CRITICAL(start);
+    // the selection is prepared when a scan completes, it's only done again if
+    // the region of interest moved since then
+    if(nextScanMask != scanMask){
+        prepareNextScan();
+    }
+    scanTimerScanStarted();
+    ADCStartConversion();
+}
+
+void cancelScanDelay(){
+    schedulerCancel(&sampleRateTimer);
+}
+
+/**
+ * @brief calculates the sensors of the next scan, in region of interest mode
+ * only a window around the line is scanned with a full scan every
+ * roiFullScanInterval scans or when the line is lost.
+ * 
+ * @param[cfgValues] current configuration.
+ * @param[line] line position of the last scan.
+ * 
+ * @return the mask for the next scan.
+ */
+static uint16_t calcNextScanMask(config_struct* cfgValues, linePosition_t* line){
+    uint16_t mask = cfgValues->scanMask;
+    if(cfgValues->roiWidth == 0 || !line->linePresent || ++roiScans >= cfgValues->roiFullScanInterval){
+        roiScans = 0;
+        return mask;
+    }
+    mask &= lineWindowMask(line, cfgValues->roiWidth);
+    return mask != 0 ? mask : cfgValues->scanMask;
+}
+
+/**
+ * @brief loads the configured INITDLY, the ADC is enabled again so the delay
+ * is applied to the next conversion. Only called between scans.
+ */
+static void applyInitDelay(){
+    initDelay = getConfig()->adcInitDelay;
+    ADC0_Disable();
+    ADC0_SetInitDelay(initDelay);
+    ADC0_Enable();
+}
+
+void ADCSampleReady(uint16_t value){
+    uint16_t result = value >> accumulationShift;
+    rawADCFrames[adcFrame][activeSensor] = resolution8Bit ? result << 2 : result;
+    if(windowCompare && ADC0_GetWindowResult()){
+        // the threshold of the current state was crossed
+        binaryState ^= (uint16_t)1 << activeSensor;
+    }
+    scanChannels++;
+    activeSensor = nextScanSensor(scanMask, activeSensor + 1);
+    if(activeSensor < IR_SENSOR_COUNT){
+        // the scans started by the scan timer are only seen here
+        scanRunning = true;
+        // the sensor was shifted in while the previous one was converting, the
+        // settle time extends the sampling time of the conversion
+        latchBits();
+        if(windowCompare){
+            loadWindow(activeSensor);
+        }
+        ADCStartConversion();
+        uint8_t next = nextScanSensor(scanMask, activeSensor + 1);
+        if(next < IR_SENSOR_COUNT){
+            prepareBits(next);
+        }
+        return;
+    }
+    // scan completed, publish the frame
+    scanRunning = false;
+    scanTimerFrameComplete(scanChannels);
+    scanChannels = 0;
+    readyMask = scanMask;
+    readyWindowCompare = windowCompare;
+    readyBinary = binaryState & scanMask;
+    readyFrame = adcFrame;
+    adcFrame ^= 1;
+    frameSequence++;
+    sensorsSampleCmplt = true;
+    eventPost(EVENT_SCAN);
+    // the accumulation, the resolution and the mask are only changed between
+    // scans so a frame never mixes results with different configurations
+    accumulationShift = getConfig()->acumulator;
+    ADC0_SetSampleAccumulation(accumulationShift);
+    resolution8Bit = getConfig()->resolution8Bit;
+    ADC0_SetResolution(resolution8Bit ? 8 : 10);
+    if(initDelay != getConfig()->adcInitDelay){
+        applyInitDelay();
+    }
+    prepareNextScan();
+}
+
+ISR(ADC0_RESRDY_vect)
+{
+    // reading the result clears the interrupt flag
+    ADCSampleReady(ADC0_GetConversionResult());
 }
 
 //IRSensor* getIrSensors(){
 //    return sensors;
 //}
 
-volatile delayRequest* getDelayRequests(){
-    return delayRequests;
-}
-
 volatile StateMachineStatus* getStateMachineStatus(){
     return &sendingStatus;
 }
 
-void ISRDelay(uint8_t ms, volatile bool* flag, void (*funPtr)(), volatile delayRequest* delayRequests, uint8_t delayIndex){
-    /*volatile delayRequest* slot = &delayRequests[delayIndex];
-    slot->delay = ms;
-    slot->flag = flag;
-    slot->funPtr = funPtr;
-    */
-    delayRequests[delayIndex].delay = ms;
-    delayRequests[delayIndex].flag = flag;
-    delayRequests[delayIndex].funPtr = funPtr;
-    //if(++delayIndex >= MAX_DELAY_REQUESTS){
-    //    delayIndex = 0;
-    //}
-    
-}
+// sensor selected in the shift registers, IR_SENSOR_COUNT forces a full load
+uint8_t shiftRegisterPos = IR_SENSOR_COUNT;
 
-void setBits(uint8_t pos){
-    setLatch(false);
+void prepareBits(uint8_t pos){
+#if SHIFT_REGISTER_BACKEND == SHIFT_REGISTER_BACKEND_SPI
+    // the 16 bits go out in hardware (LSB first, same order as the bit bang)
+    shiftRegisterSPIWrite(0x8000 >> pos);
+    return;
+#elif SHIFT_REGISTER_SEQUENTIAL
+    if(pos > shiftRegisterPos && shiftRegisterPos < IR_SENSOR_COUNT){
+        // clock and data are left low, every clock walks the bit one output,
+        // this also skips the sensors disabled in the scan mask
+        for(; shiftRegisterPos < pos; shiftRegisterPos++){
+            setClock(true);
+            setClock(false);
+        }
+        return;
+    }
+    shiftRegisterPos = pos;
+#endif
     uint32_t value = 0x8000 >> pos;
     for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
         setClock(false);
@@ -239,9 +566,21 @@ void setBits(uint8_t pos){
     
     setClock(false);
     setData(false);
+}
+
+void latchBits(){
+#if SHIFT_REGISTER_BACKEND == SHIFT_REGISTER_BACKEND_SPI
+    shiftRegisterSPIWait();
+#endif
+    setLatch(false);
     setLatch(true);
 }
 
+void setBits(uint8_t pos){
+    prepareBits(pos);
+    latchBits();
+}
+
 void updateIRData(volatile uint16_t value, IRSensor* sensor){
     sensor->value = value;
     if(sensor->value >= sensor->upper){
@@ -251,6 +590,81 @@ void updateIRData(volatile uint16_t value, IRSensor* sensor){
     }
 }
 
+/**
+ * @brief applies the exponential moving average to a new value of a sensor,
+ * state += (value - state) * alpha is done as state - state * alpha +
+ * value * alpha so it only needs shifts and no signed arithmetic.
+ * 
+ * @param[index] sensor of the value.
+ * @param[value] new 10 bit value.
+ * @param[shift] log2 of 1 / alpha, 1 to FILTER_MAX_SHIFT.
+ * 
+ * @return the filtered value.
+ */
+static uint16_t filterValue(uint8_t index, uint16_t value, uint8_t shift){
+    uint16_t bit = (uint16_t)1 << index;
+    if(filterSeeded & bit){
+        filterState[index] = filterState[index] - (filterState[index] >> shift) + (value << (6 - shift));
+    }else{
+        filterState[index] = value << 6;
+        filterSeeded |= bit;
+    }
+    return (filterState[index] + 0x20) >> 6;
+}
+
+/**
+ * @brief returns the causes to raise the interrupt after a scan with intEnable
+ * set, every scan or only the changes of the bitmap and the line position.
+ * 
+ * It's called after every scan, while the on change mode is not active the
+ * references follow the scans so enabling it doesn't compare against a stale
+ * bitmap or position.
+ * 
+ * @param[cfgValues] interrupt configuration.
+ * @param[bitmap] binary value of the sensors in the scan.
+ * @param[line] line position of the scan.
+ * 
+ * @return INT_CAUSE_* bits, 0 if the interrupt is not needed.
+ */
+static uint8_t scanInterruptCause(config_struct* cfgValues, uint16_t bitmap, linePosition_t* line){
+    bool onChange = cfgValues->intEnable && cfgValues->intOnChange && !cfgValues->eventEnable;
+    uint8_t cause = 0;
+    if(!onChange){
+        lastIntPosition = line->position;
+        cause = INT_CAUSE_SCAN;
+    }else{
+        if(bitmap != lastBitmap){
+            cause |= INT_CAUSE_BITMAP;
+        }
+        uint16_t delta = line->position > lastIntPosition ? line->position - lastIntPosition :
+                                                             lastIntPosition - line->position;
+        if(cfgValues->intPositionDelta != 0 && delta >= cfgValues->intPositionDelta){
+            cause |= INT_CAUSE_POSITION;
+            lastIntPosition = line->position;
+        }
+    }
+    lastBitmap = bitmap;
+    return cause;
+}
+
+/**
+ * @brief builds the frame sent on every completed scan in streaming mode.
+ * 
+ * @param[frame] destination, needs DATAGRAM_STREAM_SIZE bytes.
+ * @param[sensors] sensors of the completed scan.
+ * @param[sequence] sequence number of the frame.
+ */
+static void buildStreamFrame(char* frame, IRSensor* sensors, uint8_t sequence){
+    frame[0] = LS_SYNC;
+    frame[1] = LS_ADDR;
+    frame[2] = LS_REGISTER_STREAM << 1;
+    frame[3] = sequence;
+    frame[4] = frameMask & 0xFF;
+    frame[5] = frameMask >> 8;
+    registerRawIRDataAll(frame[2], NULL, &frame[6], sensors);
+    frame[DATAGRAM_STREAM_SIZE - 1] = crc8Block(frame, DATAGRAM_STREAM_SIZE - 1);
+}
+
 void initializeStateMachine(){
     
     
@@ -259,17 +673,28 @@ void initializeStateMachine(){
         sensors[i].upper = 0xFFFF;
         sensors[i].value = 0;
         sensors[i].procValue = false;
-        rawADCValues[i] = 0;
+        rawADCFrames[0][i] = 0;
+        rawADCFrames[1][i] = 0;
     }
     
-    for(uint8_t i = 0; i < MAX_DELAY_REQUESTS; i++){
-        delayRequests[i].delay = 0;
-        delayRequests[i].flag = NULL;
-        delayRequests[i].funPtr = NULL;
-    }
+    schedulerCancel(&txDelayTimer);
+    schedulerCancel(&sampleRateTimer);
+    updateNormalization(sensors);
+    loadSettings(sensors);
+    applyConfig();
     setRst(true);
-    setBits(0);
+    accumulationShift = getConfig()->acumulator;
+    ADC0_SetSampleAccumulation(accumulationShift);
+    resolution8Bit = getConfig()->resolution8Bit;
+    ADC0_SetResolution(resolution8Bit ? 8 : 10);
+    applyInitDelay();
+    ENTER_CRITICAL(initMask);
+    nextScanMask = getConfig()->scanMask;
+    EXIT_CRITICAL(initMask);
+    prepareNextScan();
     setChannel(0);
+    // stored settings, the scans start without waiting for the master
+    applyScanPeriod();
 }
 
 
@@ -277,35 +702,143 @@ void updateStateMachine(){
     config_struct* cfgValues = getConfig();
     if(received_datagram){
             received_datagram = false;
-            if(processDatagram(rx, tx, sensors)){
-                ISRDelay(cfgValues->txDelay,&reply, NULL, delayRequests, TXDELAY);
+            eventHandled(EVENT_DATAGRAM);
+            // any datagram stops the stream, the stream register itself is
+            // read or written with it running so a read reports it enabled
+            if((rx[2] & 0xFE) >> 1 != LS_REGISTER_STREAM){
+                cfgValues->streamEnable = false;
+            }
+            if(processDatagram(rx, tx, &txSize, sensors)){
+                replyPending = true;
+                if(cfgValues->protocolVersion == PROTOCOL_VERSION_LEGACY){
+                    reply = false;
+                    schedulerStart(&txDelayTimer, (uint32_t)cfgValues->txDelay * 1000, NULL, replyDelayExpired);
+                }
             }else{
+                schedulerCancel(&txDelayTimer);
+                reply = false;
+                eventDiscard(EVENT_REPLY);
                 USART0_SetReceiveCompleteISR(true);
                 //USART0.CTRLA |= USART_RXCIE_bm;
             }
         }
-        if(reply == true){
+        if(reply == true && replyPending){
             //sendInt(false);
             reply = false;
-            USART0_oneWireSend((char*)tx, 8);
+            replyPending = false;
+            eventHandled(EVENT_REPLY);
+            USART0_oneWireSend((char*)tx, txSize);
             USART0_SetReceiveCompleteISR(true);
             //USART0.CTRLA |= USART_RXCIE_bm;
+            if(interruptAck != 0){
+                // causes raised after the read stay pending with the pin
+                interruptCause &= ~interruptAck;
+                interruptAck = 0;
+                if(interruptCause == 0){
+                    sendInt(false);
+                }
+            }
         }
         
-        //volatile bool* sensorsSampleCmplt = getSensorsSampleFlag();
-        if(sensorsSampleCmplt && received_datagram == false){
+        // the ISR keeps writing in the other frame, so the completed one can be
+        // consumed even while a datagram is being processed
+        if(sensorsSampleCmplt){
             sensorsSampleCmplt = false;
+            eventHandled(EVENT_SCAN);
+            ENTER_CRITICAL(frame);
+            volatile uint16_t* rawADCValues = rawADCFrames[readyFrame];
+            uint8_t sequence = frameSequence;
+            uint16_t mask = readyMask;
+            bool binaryReady = readyWindowCompare;
+            uint16_t binary = readyBinary;
+            uint32_t timestamp = scanTimerGetTimestamp();
+            EXIT_CRITICAL(frame);
+            
+            uint16_t values[IR_SENSOR_COUNT];
+            for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
+                values[i] = rawADCValues[i];
+            }
+            if(sequence != frameSequence){
+                // another scan completed during the copy and the ADC went back
+                // to this frame, the new one is processed in the next pass
+                return;
+            }
             
+            // the window comparator decides on the raw conversions, the values
+            // aren't filtered so they agree with the binary ones
+            uint8_t filterShift = binaryReady ? 0 : cfgValues->filterShift;
+            filterSeeded = filterShift == 0 ? 0 : filterSeeded & mask;
+            // in window comparator mode the bitmap comes from the conversion
+            // path, otherwise it's built while the sensors are compared
+            uint16_t bitmap = binaryReady ? binary & mask : 0;
             for(uint8_t i = 0; i < IR_SENSOR_COUNT; i++){
-                updateIRData(rawADCValues[i], &sensors[i]);
+                uint16_t value = values[i];
+                if(filterShift != 0 && ((mask >> i) & 1)){
+                    value = filterValue(i, value, filterShift);
+                }
+                if(((mask >> i) & 1) && binaryReady){
+                    // the binary value was already set by the window comparator
+                    sensors[i].value = value;
+                    sensors[i].procValue = (binary >> i) & 1;
+                }else if((mask >> i) & 1){
+                    updateIRData(value, &sensors[i]);
+                    bitmap |= (uint16_t)sensors[i].procValue << i;
+                }else{
+                    sensors[i].value = IR_SENSOR_MASKED_VALUE;
+                    sensors[i].procValue = false;
+                }
             }
-            if(cfgValues->intEnable){
+            frameMask = mask;
+            // while calibrating only the completion of the sweep is reported
+            bool calibrating = calibrationRunning();
+            bool calibrated = calibrationUpdate(sensors, mask);
+            if(calibrated){
+                updateNormalization(sensors);
+            }
+            updateLinePosition(sensors, mask, getLinePosition());
+            updateLineMotion(getLinePosition(), timestamp);
+            uint16_t nextMask = calcNextScanMask(cfgValues, getLinePosition());
+            // the mask is read by the ADC ISR and by startScan from the
+            // scheduler ISR, a torn write could select no sensor
+            ENTER_CRITICAL(nextMaskUpdate);
+            nextScanMask = nextMask;
+            if(scanTimerGetPeriod() != 0 && nextScanMask != scanMask && !scanRunning &&
+               !ADC0_IsConversionRunning() && !ADC0_IsConversionDone()){
+                // the ISR latched the selection before the mask was known, the
+                // timer hasn't started the next scan yet so it gets the window
+                prepareNextScan();
+            }
+            EXIT_CRITICAL(nextMaskUpdate);
+            uint8_t cause = calibrated ? INT_CAUSE_CALIBRATION : 0;
+            if(!calibrating){
+                lineEvent_t event = lineEventUpdate(bitmap, mask, cfgValues);
+                uint8_t scanCause = scanInterruptCause(cfgValues, bitmap, getLinePosition());
+                if(cfgValues->eventEnable){
+                    // only the features of the track are reported
+                    cause |= event != LINE_EVENT_NONE ? INT_CAUSE_EVENT : 0;
+                }else if(cfgValues->intEnable){
+                    cause |= scanCause;
+                }
+            }
+            if(cause != 0){
+                interruptCause |= cause;
                 sendInt(true);
             }
-            if(cfgValues->sampleRate == 0){
-                ADCStartConversion();
-            }else{
-                ISRDelay(cfgValues->sampleRate, NULL, ADCStartConversion, delayRequests, SAMPLE_RATE);
+            // the frame is built in tx, it would overwrite the reply, and the
+            // receiver can't be enabled again while rx holds an unread datagram
+            if(cfgValues->streamEnable && !replyPending && !received_datagram){
+                buildStreamFrame(tx, sensors, ++streamSequence);
+                USART0_oneWireSend(tx, DATAGRAM_STREAM_SIZE);
+                ENTER_CRITICAL(streamSent);
+                if(!received_datagram){
+                    USART0_SetReceiveCompleteISR(true);
+                }
+                EXIT_CRITICAL(streamSent);
+            }
+            // with a scan period the next scan is started by the hardware timer
+            if(scanTimerGetPeriod() == 0){
+                // a sampleRate of 0 starts the scan right away
+                schedulerStart(&sampleRateTimer, (uint32_t)cfgValues->sampleRate * 1000, NULL, startScan);
             }
             
         }
@@ -317,6 +850,10 @@ StateMachineStatus waitSendConfirmation(void)
     volatile StateMachineStatus* sendingStatus = getStateMachineStatus();
     *sendingStatus = SENDING;
     /* Will change inside RXC interrupt handler */
-    while(*sendingStatus == SENDING);
+    ENTER_CRITICAL(wait);
+    while(*sendingStatus == SENDING){
+        sleepIdle();
+    }
+    EXIT_CRITICAL(wait);
     return *sendingStatus;
 }
\ No newline at end of file
@@ -48,26 +48,6 @@ typedef enum {
     CONFLICT,
 } StateMachineStatus;
 
-/**
- * @struct delayRequest
- *
- * @brief this struct is used to configure code that will execute after a delay.
- * 
- * delay:  counter used to measure the elapsed time, once it reaches zero the
- *         function is executed if funPtr is not NULL and the flag is set to true
- *         if it's also not NULL.
- * flag:   a pointer to a boolean flag that is going to be set to True when the
- *         value of the delay variable is zero, if this pointer is NULL no update
- *         id performed.
- * funPtr: function pointer that's going to be called when the delay variable
- *         reaches zero, if this pointer is NULL nothing is called.
- */  
-typedef struct{
-    int8_t delay;
-    volatile bool* flag;
-    void (*funPtr)();
-}delayRequest;
-
 
 /**
  * @brief This function returns a pointer to the RX buffer used by the state
@@ -87,8 +67,11 @@ volatile char* getRxBuffer();
 volatile uint8_t* getActiveSensor();
 
 /**
- * @brief returns the array containing the raw ADC values for the IR sensors,
- * the size of the array is configured by IR_SENSOR_COUNT
+ * @brief returns the array containing the raw ADC values of the last completed
+ * scan, the size of the array is configured by IR_SENSOR_COUNT
+ * 
+ * The ADC writes in a second array while scanning, this one is not modified
+ * until the next scan completes.
  * 
  * @return a volatile array of uint16_t type.
  * 
@@ -96,6 +79,49 @@ volatile uint8_t* getActiveSensor();
  */
 volatile uint16_t* getRawADCValues();
 
+/**
+ * @brief starts a scan from software, the sensors scanned are the ones enabled
+ * in the scan mask reduced to the region of interest when it's enabled.
+ * 
+ * When the scan timer is enabled the scans are started by hardware and this
+ * function is not used. It does nothing while a scan is running, so it can be
+ * called when the scans may already be running (e.g. enabling them again).
+ */
+void startScan();
+
+/**
+ * @brief cancels the software delay before the next scan, used when the scan
+ * timer takes over starting the scans.
+ */
+void cancelScanDelay();
+
+/**
+ * @brief stores the result of a conversion and moves the scan to the next
+ * sensor, it's called from the ADC0 RESRDY ISR with the conversion result.
+ * 
+ * The scan is pipelined, the next sensor is shifted in while the current one
+ * converts, so here it only needs to be latched before the conversion starts,
+ * the settle time of the sensor extends the ADC sampling time.
+ * 
+ * In window comparator mode the thresholds of each sensor are loaded in the
+ * ADC window comparator before its conversion and the binary value is updated
+ * here, so the main loop doesn't need to compare every sensor.
+ * 
+ * Only the sensors enabled in the scan mask are converted, the mask is
+ * calculated by the main loop after every scan (scan mask and region of
+ * interest) and latched here when the scan completes.
+ * 
+ * When the last sensor is stored the frame is published with an atomic swap of
+ * the frame indexes and the sample complete flag is set, the ADC continues in
+ * the other frame so the one being read is never modified.
+ * 
+ * @param[value] result of the conversion of the active sensor.
+ * 
+ * @see getRawADCValues
+ * @see getSensorsSampleFlag
+ */
+void ADCSampleReady(uint16_t value);
+
 /**
  * @brief returns the flag used to mark when all the IR sensors have been
  * sampled by the ADC.
@@ -105,23 +131,66 @@ volatile uint16_t* getRawADCValues();
 volatile bool* getSensorsSampleFlag();
 
 /**
- * @brief returns a pointer to the delay requests array, this is used to store when a
- * flag or function needs to be executed. 
+ * @brief returns the sensors converted in the frame stored in the IRSensor
+ * array, the ones that are not in it were skipped by the scan mask or the
+ * region of interest.
+ * 
+ * @return one bit per sensor, sensor 0 in bit 0.
+ */
+uint16_t getFrameMask();
+
+/**
+ * @brief returns the causes of the interrupts raised since the last
+ * acknowledged read, they are cleared when the reply carrying them is sent.
  * 
- * @return a volatile pointer of delayRequest.
+ * @return INT_CAUSE_* bits.
+ */
+uint8_t readInterruptCause();
+
+/**
+ * @brief selects how setBits updates the shift registers at build time.
+ * 
+ * 0: the 16 bits are clocked out every time a sensor is selected.
+ * 1: since the pattern is one hot, selecting the next sensor is done with a
+ *    single clock and latch, the whole pattern is only loaded at the start of
+ *    a scan or when jumping to a sensor that is not the next one.
  * 
- * @see delayRequest
+ * It only applies to the bit bang backend, the SPI backend always shifts the
+ * whole pattern since it can't send a single clock.
  */
-volatile delayRequest* getDelayRequests();
+#ifndef SHIFT_REGISTER_SEQUENTIAL
+#define SHIFT_REGISTER_SEQUENTIAL 1
+#endif
 
 /**
  * @brief controls which IR sensor is going to be read and configures the shift
  * registers accordingly.
  * @param pos, receives the position of the sensor, it's responsibility of the
  * developer to send a value lower than IR_SENSOR_COUNT
+ * 
+ * @see SHIFT_REGISTER_SEQUENTIAL
  */
 void setBits(uint8_t pos);
 
+/**
+ * @brief shifts the pattern of a sensor in to the shift registers without
+ * changing their outputs, the sensor is selected later with latchBits.
+ * 
+ * This allows shifting the next sensor while the current one is still being
+ * converted by the ADC.
+ * 
+ * @param pos, position of the sensor, lower than IR_SENSOR_COUNT.
+ * 
+ * @see latchBits
+ */
+void prepareBits(uint8_t pos);
+
+/**
+ * @brief moves the pattern shifted by prepareBits to the outputs of the shift
+ * registers.
+ */
+void latchBits();
+
 /**
  * @brief updates the IRSensor struct with the value passed, this includes the
  * update of the binary value.
@@ -137,22 +206,34 @@ void updateIRData(volatile uint16_t value, IRSensor* sensor);
 /**
  * @brief initializes the state machine variables for a clean start
  * 
- * the delay requests are set to NULL to avoid calling garbage code,
+ * the pending timers of the state machine are stopped,
  * the sensor array (IRSensor) is set to 0 values 
  * the shift registers are configured to 0 output, with this no IR sensor is
  * active.
+ * If the EEPROM holds valid settings the configuration and the calibration
+ * are loaded from it and, if the stored config is enabled, the first scan is
+ * started right away.
  */
 void initializeStateMachine();
 
 /**
- * @brief updates the global state machine in 3 steps
+ * @brief updates the global state machine in 5 steps
  * 1. check if a datagram was received process it and creates a response if required
  * 2. if the elapsed time for a response has passed, then send the response,
- * this is configured by the TXDELAY in the conf.h file or in the config register
+ * this is configured by txDelay in the config register, with the bit time
+ * protocol the delay is started by the parser when the request ends
  * 3. updates the IR values when a sample is completed and if the interrupt is
  * enabled it sets the pin to high
- * 4. sets the next sample rate according to the SAMPLE_RATE configuration for
- *  measurements.
+ * 4. schedules the next scan according to the sampleRate configuration, or
+ *  leaves it to the scan timer when it's enabled.
+ * 5. if streaming is enabled the completed scan is sent to the master, a
+ *  write to a register other than the stream register disables the
+ *  streaming and no frame is sent while a reply is pending.
+ * 
+ * Every step is triggered by an event posted by an ISR, the main loop calls
+ * eventWait after it to sleep until the next one.
+ * 
+ * @see event_loop.h
  */
 void updateStateMachine();
 
@@ -161,7 +242,7 @@ void updateStateMachine();
  * port.
  * 
  * this function is used when the USART can only send one byte at a time and
- * triggers an ISR each time.
+ * triggers an ISR each time, the CPU sleeps in IDLE while it waits.
  * 
  * @return state machine status, if the char was sent successfully then it'll
  * have the value OK.
@@ -179,27 +260,21 @@ StateMachineStatus waitSendConfirmation(void);
 volatile StateMachineStatus* getStateMachineStatus();
 
 /**
- * @brief function to register operations to be executed later, it can be the
- * setting of a flag to true or a function call.
- * 
- * The developer needs to take in to account that the functions are going to be
- * executed in an ISR context, if it must be outside the ISR then use the flag.
- * 
- * 
- * @param[ms] the amount of milliseconds that need to pass to execute the function
- * or change the flag.
- * @param[flag] a pointer to the flag that is going to be changed, it can be NULL
- * if not used.
- * @param[funPtr] function pointer to the function that is going to be executed,
- * it can be NULL.
- * @param[delayRequests] array where the delay request is going to be stored.
- * @param[delayIndex] position in the array for the operation, at this moment
- * the positions of the array are reserved for specific operations.
- * 
- * @see delayRequest
+ * @brief advances the datagram parser with one received byte, this is called
+ * from the USART receive ISR.
+ *
+ * The CRC of the datagram is updated with every byte, so when the CRC byte
+ * arrives the validation is a single compare and received_datagram is set
+ * without walking the buffer again.
+ *
+ * @param[byte] the received byte.
+ * @param[rxBuff] buffer where the ISR stores the datagram.
+ *
+ * @return true if the byte was accepted and the next one belongs to the same
+ * datagram, false when the datagram ended or the byte was rejected.
+ *
+ * @see crc8Update
  */
-void ISRDelay(uint8_t ms, volatile bool* flag, void (*funPtr)(), volatile delayRequest* delayRequests, uint8_t delayIndex);
-
 bool datagramStateMachineProcessByte(volatile uint8_t byte, volatile char* rxBuff);
 
 /**
@@ -209,18 +284,21 @@ bool datagramStateMachineProcessByte(volatile uint8_t byte, volatile char* rxBuf
  *
  * @param[in] datagram A pointer to the volatile character array containing the incoming datagram.
  * @param[out] response A pointer to the character array to store the generated response.
+ * @param[out] responseSize the amount of bytes of the response including the CRC,
+ * DATAGRAM_RESPONSE_SIZE for most registers and DATAGRAM_BULK_RESPONSE_SIZE for
+ * the bulk read registers.
  * @param[in,out] sensors A pointer to the IRSensor structure containing data from infrared sensors.
  *
  * @return A boolean value indicating the success of processing the datagram.
  * @retval true The datagram was successfully processed and a response was generated.
  * @retval false An error occurred during processing.
  *
- * @warning The datagram and response buffers must be appropriately sized to avoid buffer overflows.
+ * @warning The response buffer must hold DATAGRAM_MAX_RESPONSE_SIZE bytes.
  * @note It is the caller's responsibility to manage memory for the response buffer.
  *
  * @see IRSensor
  */
-bool processDatagram(volatile char* datagram, char* response, IRSensor* sensors);
+bool processDatagram(volatile char* datagram, char* response, uint8_t* responseSize, IRSensor* sensors);
 
 
 #ifdef	__cplusplus
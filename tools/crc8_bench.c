@@ -0,0 +1,99 @@
+/*
+ * File:                crc8_bench.c
+ * Comments:            host benchmark of the datagram CRC, it checks that
+ *                      crc8Block matches the bit serial loop the firmware used
+ *                      before (datagramCalcCRC) and times both.
+ *
+ * It's not part of the firmware, build it with the host gcc from the root of
+ * the repository, once per lookup strategy:
+ *
+ *   gcc -O2 -o crc8_bench tools/crc8_bench.c
+ *   gcc -O2 -DCRC8_USE_FULL_TABLE=1 -o crc8_bench tools/crc8_bench.c
+ *
+ * The times are host times, they compare the algorithms but not the cycles
+ * they take on the ATtiny404.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// crc8.h pulls the device headers, the definitions the engine needs are given
+// here so crc8.c builds on the host
+#define CRC8_H
+#define CRC8_INIT 0x00
+#ifndef CRC8_USE_FULL_TABLE
+#define CRC8_USE_FULL_TABLE 0
+#endif
+uint8_t crc8Update(uint8_t crc, uint8_t byte);
+uint8_t crc8Final(uint8_t crc);
+uint8_t crc8Block(const char* data, uint8_t length);
+#include "../crc8.c"
+
+#define BENCH_LENGTH        24
+#define BENCH_BUFFERS       256
+#define BENCH_ITERATIONS    20000
+
+/**
+ * @brief CRC of the previous firmware, bit by bit through a volatile value
+ * like datagramCalcCRC did with the last byte of the datagram.
+ */
+static uint8_t crc8BitLoop(const char* data, uint8_t length){
+    volatile char crc = 0;
+    for(uint8_t i = 0; i < length; i++){
+        char currentByte = data[i];
+        for(uint8_t j = 0; j < 8; j++){
+            if(((uint8_t)crc >> 7) ^ (currentByte & 0x01)){
+                crc = (crc << 1) ^ 0x07;
+            }else{
+                crc = crc << 1;
+            }
+            currentByte = (uint8_t)currentByte >> 1;
+        }
+    }
+    return crc;
+}
+
+static double benchmark(uint8_t (*crc)(const char*, uint8_t), char buffers[][BENCH_LENGTH], uint8_t* sink){
+    clock_t start = clock();
+    for(uint32_t n = 0; n < BENCH_ITERATIONS; n++){
+        for(uint16_t i = 0; i < BENCH_BUFFERS; i++){
+            *sink ^= crc(buffers[i], BENCH_LENGTH);
+        }
+    }
+    double bytes = (double)BENCH_ITERATIONS * BENCH_BUFFERS * BENCH_LENGTH;
+    return (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / bytes;
+}
+
+int main(void){
+    static char buffers[BENCH_BUFFERS][BENCH_LENGTH];
+    srand(1);
+    for(uint16_t i = 0; i < BENCH_BUFFERS; i++){
+        for(uint8_t j = 0; j < BENCH_LENGTH; j++){
+            buffers[i][j] = rand() & 0xFF;
+        }
+    }
+
+    // every length of every buffer must give the same CRC
+    for(uint16_t i = 0; i < BENCH_BUFFERS; i++){
+        for(uint8_t length = 0; length <= BENCH_LENGTH; length++){
+            uint8_t expected = crc8BitLoop(buffers[i], length);
+            uint8_t crc = crc8Block(buffers[i], length);
+            if(crc != expected){
+                printf("mismatch buffer %u length %u: 0x%02X != 0x%02X\n", i, length, crc, expected);
+                return 1;
+            }
+        }
+    }
+
+    uint8_t sink = 0;
+    double bitLoop = benchmark(crc8BitLoop, buffers, &sink);
+    double table = benchmark(crc8Block, buffers, &sink);
+    printf("%s table, %u bytes per datagram (sink 0x%02X)\n",
+           CRC8_USE_FULL_TABLE ? "full" : "nibble", BENCH_LENGTH, sink);
+    printf("bit loop: %.2f ns/byte\n", bitLoop);
+    printf("crc8:     %.2f ns/byte (%.1fx)\n", table, bitLoop / table);
+    return 0;
+}